@@ -39,11 +39,48 @@
 #include "SevSeg.h"
 #include <avr/pgmspace.h>
 
-#define BLANK 10 // Must match with 'digitCodeMap', defined in 'setDigitCodes' 
+#define BLANK 10 // Must match with 'digitCodeMap'
 #define DASH 11
 
 
-const long SevSeg::powersOf10[] = {
+// Gamma curve from perceived brightness (0..255) to LED duty cycle (0..65535),
+// built at compile time. S7_GAMMA approximates x^2.5 with integers only:
+// the average of x^2 and x^3, scaled to 0..65535. 16 bits keep the lowest
+// levels apart, where the curve rises by less than 1/255 per level.
+#define S7_GAMMA(x)   (((unsigned long long)(x) * (x) * (255ULL + (x)) * \
+                        257ULL + 65025ULL) / 130050ULL)
+#define S7_GAMMA4(x)   S7_GAMMA(x),    S7_GAMMA((x) + 1), \
+                       S7_GAMMA((x) + 2), S7_GAMMA((x) + 3)
+#define S7_GAMMA16(x)  S7_GAMMA4(x),   S7_GAMMA4((x) + 4), \
+                       S7_GAMMA4((x) + 8), S7_GAMMA4((x) + 12)
+#define S7_GAMMA64(x)  S7_GAMMA16(x),  S7_GAMMA16((x) + 16), \
+                       S7_GAMMA16((x) + 32), S7_GAMMA16((x) + 48)
+
+const uint16_t SevSegBase::gammaTable[256] PROGMEM = {
+  S7_GAMMA64(0), S7_GAMMA64(64), S7_GAMMA64(128), S7_GAMMA64(192)};
+
+
+// The codes below indicate which segments must be illuminated to display
+// each number.
+const byte SevSegBase::digitCodeMap[] = {
+// Segments:    [see setSegments() for bit/segment mapping]
+// HGFEDCBA  // Char:
+  B00111111, // 0
+  B00000110, // 1
+  B01011011, // 2
+  B01001111, // 3
+  B01100110, // 4
+  B01101101, // 5
+  B01111101, // 6
+  B00000111, // 7
+  B01111111, // 8
+  B01101111, // 9
+  B00000000, // BLANK
+  B01000000, // DASH
+};
+
+
+const long SevSegBase::powersOf10[] = {
   1, // 10^0
   10,
   100,
@@ -56,13 +93,59 @@ const long SevSeg::powersOf10[] = {
   1000000000}; // 10^9
 
 
-// SevSeg
+// SevSegBase, SevSeg
 /******************************************************************************/
-SevSeg::SevSeg()
+// 'digitData' holds the per-digit arrays, 'frameData' the compiled frames (see
+// S7_DIGIT_DATA and S7_FRAME_DATA).
+
+SevSegBase::SevSegBase(byte maxDigitsIn, byte maxStepsIn,
+                       byte digitData[], byte frameData[]) :
+  digitCodes(digitData),
+  maxDigits(maxDigitsIn),
+  maxSteps(maxStepsIn),
+  digitPins(digitData + maxDigitsIn),
+  digitPort(digitData + 2 * maxDigitsIn),
+  digitMask(digitData + 3 * maxDigitsIn),
+  digitValues(digitData + 4 * maxDigitsIn),
+  sentCodes(digitData + 5 * maxDigitsIn),
+  frames(frameData)
 {
   // Initial value
   ledOnTime = 2000; // Corresponds to a brightness of 100
+  duty = 0xFFFF;
+  compensation = 0;
+  output = S7_OUTPUT_PINS;
+#ifdef S7_PORT_IO
+  portIO = true;
+#endif
+  sendAll = false;
+  displayOn = true;
   numDigits = 0;
+  numSteps = 0;
+  common = 0;
+  plane = 0;
+  stepStart = 0;
+  front = 0;
+  back = 1;
+  framePending = false;
+  pendingLeft = false;
+  stepFrames = frames + S7_FRAME_SIZE(maxSteps);
+  skipEmpty = true;
+  minTransitions = false;
+  numberShown = false;
+  codesSequence = 0;
+  conversions = skippedConversions = 0;
+  number = 0;
+  numberDecPlaces = 0;
+  scanPos = 0;
+  latest = back; // Nothing to copy into the first frame
+  for (byte slot=0 ; slot < S7_FRAMES ; slot++) {
+    scanLength[slot] = 0;
+  }
+}
+
+SevSeg::SevSeg() : SevSegBase(S7_DIGITS, S7_STEPS, digitData, frameData)
+{
 }
 
 
@@ -71,11 +154,38 @@ SevSeg::SevSeg()
 // Saves the input pin numbers to the class and sets up the pins to be used.
 
 void SevSeg::begin(const byte hardwareConfig, const byte numDigitsIn,
-                   const byte digitPinsIn[],  const byte segmentPinsIn[]) {
+                   const byte digitPinsIn[],  const byte segmentPinsIn[],
+                   const byte resistorsIn) {
+  SevSegBase::begin(hardwareConfig, numDigitsIn, digitPinsIn, segmentPinsIn,
+                    resistorsIn);
+}
+
+void SevSegBase::begin(const byte hardwareConfig, const byte numDigitsIn,
+                       const byte digitPinsIn[],  const byte segmentPinsIn[],
+                       const byte resistorsIn) {
                     
   numDigits = numDigitsIn;
   //Limit the max number of digits to prevent overflowing
-  if (numDigits > S7_DIGITS) numDigits = S7_DIGITS;
+  if (numDigits > maxDigits) numDigits = maxDigits;
+
+  //For resistors on *digits* we will cycle through all 8 segments (7 + period),
+  //turning on the *digits* as appropriate for a given segment.
+  //For resistors on *segments* we will cycle through all digits, turning on the
+  //*segments* as appropriate for a given digit.
+  resistors = resistorsIn;
+#ifdef S7_CHARLIEPLEX
+  if (output == S7_OUTPUT_CHARLIEPLEX) {
+    resistors = S7_R_ON_SEGMENTS; // One step per digit
+  }
+#endif
+  if (resistors == S7_R_ON_SEGMENTS) {
+    numSteps = numDigits;
+  }
+  else {
+    numSteps = S7_SEGMENTS;
+  }
+  common = 0;
+  scanPos = 0;
 
   switch (hardwareConfig){
 
@@ -103,6 +213,38 @@ void SevSeg::begin(const byte hardwareConfig, const byte numDigitsIn,
   digitOff = !digitOn;
   segmentOff = !segmentOn;
 
+  if (isController()) {
+    beginController();
+  }
+  else {
+    beginPins(digitPinsIn, segmentPinsIn);
+  }
+
+  // All digits at full brightness
+  for (byte bit=0 ; bit < S7_BCM_BITS ; bit++) {
+    for (byte port=0 ; port < numPorts ; port++) {
+      planeMask[bit][port] = portMask[port];
+    }
+  }
+
+  // Compile a blank display for the new pins, then set it to 0
+  for (byte digit=0 ; digit < numDigits ; digit++) {
+    digitCodes[digit] = 0;
+  }
+  compileFrames();
+  setNewNum(0,0);
+  while (framesQueued()) swapFrames(); // And display it straight away
+  if (isController()) {
+    switchOn();
+  }
+}
+
+
+// beginPins
+/******************************************************************************/
+// Sets up the pins (or shift register outputs) driving the display.
+
+void SevSegBase::beginPins(const byte digitPinsIn[], const byte segmentPinsIn[]) {
   // Save the input pin numbers to library variables
   for (byte segmentNum = 0 ; segmentNum < 8 ; segmentNum++) {
     segmentPins[segmentNum] = segmentPinsIn[segmentNum];
@@ -113,76 +255,877 @@ void SevSeg::begin(const byte hardwareConfig, const byte numDigitsIn,
   }
 
   // Set the pins as outputs, and turn them off
+  if (output == S7_OUTPUT_595) {
+    beginShiftRegisters();
+  }
+#ifdef S7_CHARLIEPLEX
+  else if (output == S7_OUTPUT_CHARLIEPLEX) {
+    // Off is high impedance, without pull-ups
+    for (byte digit=0 ; digit < numDigits ; digit++) {
+      pinMode(digitPins[digit], INPUT);
+      digitalWrite(digitPins[digit], LOW);
+    }
+    for (byte segmentNum=0 ; segmentNum < 8 ; segmentNum++) {
+      pinMode(segmentPins[segmentNum], INPUT);
+      digitalWrite(segmentPins[segmentNum], LOW);
+    }
+  }
+#endif
+  else {
+    for (byte digit=0 ; digit < numDigits ; digit++) {
+      pinMode(digitPins[digit], OUTPUT);
+      digitalWrite(digitPins[digit], digitOff);
+    }
+
+    for (byte segmentNum=0 ; segmentNum < 8 ; segmentNum++) {
+      pinMode(segmentPins[segmentNum], OUTPUT);
+      digitalWrite(segmentPins[segmentNum], segmentOff);
+    }
+  }
+
+  resolvePins();
+
+  // The pins were all switched off above. Shift registers have not been
+  // written yet, so make sure they are.
+  for (byte port=0 ; port < numPorts ; port++) {
+    portState[port] = portOff[port];
+#ifdef S7_CHARLIEPLEX
+    modeState[port] = 0;
+#endif
+  }
+  if (output == S7_OUTPUT_595) {
+    portState[0] = ~portOff[0];
+    writePorts(portOff);
+  }
+}
+
+
+// resolvePins & resolvePin
+/******************************************************************************/
+// Finds the port and bit mask of every pin, for the refresh functions.
+// With direct port access, pins spread over more than S7_PORTS ports do not
+// fit: they are then all resolved again without it, to be driven with
+// digitalWrite() (see writePort()), rather than leave some of them unused.
+
+void SevSegBase::resolvePins() {
+#ifdef S7_PORT_IO
+  portIO = true;
+#endif
+  for (byte pass=0 ; pass < 2 ; pass++) {
+    numPorts = 0;
+    for (byte digit=0 ; digit < numDigits ; digit++) {
+      resolvePin(digitPins[digit], digit, digitOff,
+                 digitPort[digit], digitMask[digit]);
+    }
+    for (byte segmentNum=0 ; segmentNum < 8 ; segmentNum++) {
+      resolvePin(segmentPins[segmentNum], numDigits + segmentNum, segmentOff,
+                 segmentPort[segmentNum], segmentMask[segmentNum]);
+    }
+#ifdef S7_PORT_IO
+    if (portIO) return; // Otherwise, again without port access
+#else
+    return;
+#endif
+  }
+}
+
+// Finds the port and bit mask of a pin, and registers the port with its 'off'
+// level. 'index' is the position of the pin in the display (digits first),
+// which only matters without direct port access.
+// With shift registers, the ports are the registers of the chain, and 'pin' is
+// the number of an output along the chain.
+// A charlieplexed pin may be both a digit and a segment pin: it is off (high
+// impedance) whatever its role, and without direct port access, it goes by the
+// index of its line (see useCharlieplexing()).
+// Pins that would need more than S7_PORTS ports are left unused: without
+// direct port access, that only happens with S7_PORTS below S7_PIN_PORTS.
+
+void SevSegBase::resolvePin(byte pin, byte index, boolean offLevel,
+                        byte &port, byte &mask) {
+#ifdef S7_CHARLIEPLEX
+  if (output == S7_OUTPUT_CHARLIEPLEX) {
+    offLevel = LOW;
+    if (index >= numDigits) index -= numDigits - 1; // Segment s on line s + 1
+  }
+#endif
+#ifdef S7_PORT_IO
+  if (output != S7_OUTPUT_595 && portIO) {
+    S7PortReg *reg = portOutputRegister(digitalPinToPort(pin));
+    mask = digitalPinToBitMask(pin);
+    for (port = 0 ; port < numPorts ; port++) {
+      if (portReg[port] == reg) break;
+    }
+    if (port == numPorts) {
+      if (numPorts == S7_PORTS) { // No room left: see resolvePins()
+        portIO = false;
+        port = 0;
+        mask = 0;
+        return;
+      }
+      portReg[port] = reg;
+#ifdef S7_CHARLIEPLEX
+      modeReg[port] = portModeRegister(digitalPinToPort(pin));
+#endif
+      portMask[port] = 0;
+      portOff[port] = 0;
+      numPorts++;
+    }
+  }
+  else
+#endif
+  {
+    if (output != S7_OUTPUT_595) pin = index;
+    port = pin / 8;
+    mask = 1 << (pin % 8);
+    if (port >= S7_PORTS) { // No room left: see S7_PORTS
+      port = 0;
+      mask = 0;
+      return;
+    }
+    for ( ; numPorts <= port ; numPorts++) {
+      portMask[numPorts] = 0;
+      portOff[numPorts] = 0;
+    }
+  }
+
+  portMask[port] |= mask;
+  if (offLevel) {
+    portOff[port] |= mask;
+  }
+}
+
+
+// writePort
+/******************************************************************************/
+// Sets the display pins of a port to the levels in 'value', in a single
+// read-modify-write of the port register. The other pins are left untouched.
+// 'portState' shadows the levels last written, so that nothing is written
+// when they do not change (e.g. when switching off a display that is already
+// off), and only the pins that change are written without port access.
+
+void SevSegBase::writePort(byte port, byte value) {
+#ifdef S7_PORT_IO
+  if (portIO) {
+    S7PortReg *reg = portReg[port];
+    const byte oldSREG = SREG; // The port may be shared with an interrupt
+    cli();
+    if (value != portState[port]) {
+      *reg = (*reg & ~portMask[port]) | value;
+      portState[port] = value;
+    }
+    SREG = oldSREG;
+    return;
+  }
+#endif
+  const byte changed = value ^ portState[port];
+  if (!changed) return;
+  portState[port] = value;
   for (byte digit=0 ; digit < numDigits ; digit++) {
-    pinMode(digitPins[digit], OUTPUT);
-    digitalWrite(digitPins[digit], digitOff);
+    if (digitPort[digit] == port && (changed & digitMask[digit])) {
+      digitalWrite(digitPins[digit], (value & digitMask[digit]) ? HIGH : LOW);
+    }
   }
+  for (byte segment=0 ; segment < S7_SEGMENTS ; segment++) {
+    if (segmentPort[segment] == port && (changed & segmentMask[segment])) {
+      digitalWrite(segmentPins[segment], (value & segmentMask[segment]) ? HIGH : LOW);
+    }
+  }
+}
+
 
-  for (byte segmentNum=0 ; segmentNum < 8 ; segmentNum++) {
-    pinMode(segmentPins[segmentNum], OUTPUT);
-    digitalWrite(segmentPins[segmentNum], segmentOff);
+#ifdef S7_CHARLIEPLEX
+// Same as writePort(), for the pin modes of a charlieplexed display: a 1 makes
+// the pin an output.
+void SevSegBase::writeMode(byte port, byte value) {
+#ifdef S7_PORT_IO
+  if (portIO) {
+    S7PortReg *reg = modeReg[port];
+    const byte oldSREG = SREG;
+    cli();
+    if (value != modeState[port]) {
+      *reg = (*reg & ~portMask[port]) | value;
+      modeState[port] = value;
+    }
+    SREG = oldSREG;
+    return;
+  }
+#endif
+  const byte changed = value ^ modeState[port];
+  if (!changed) return;
+  modeState[port] = value;
+  for (byte digit=0 ; digit < numDigits ; digit++) {
+    if (digitPort[digit] == port && (changed & digitMask[digit])) {
+      pinMode(digitPins[digit], (value & digitMask[digit]) ? OUTPUT : INPUT);
+    }
+  }
+  for (byte segment=0 ; segment < S7_SEGMENTS ; segment++) {
+    if (segmentPort[segment] == port && (changed & segmentMask[segment])) {
+      pinMode(segmentPins[segment], (value & segmentMask[segment]) ? OUTPUT : INPUT);
+    }
   }
+}
+#endif
+
+
+// writePorts
+/******************************************************************************/
+// Sets every display port, through the output in use.
 
-  setNewNum(0,0); // Initialise the number displayed to 0
+void SevSegBase::writePorts(const byte values[]) {
+  if (output == S7_OUTPUT_595) {
+    shiftPorts(values);
+    return;
+  }
+  for (byte port=0 ; port < numPorts ; port++) {
+    writePort(port, values[port]);
+  }
 }
 
 
-// lightsOn & lightsOff
+// useShiftRegisters, beginShiftRegisters & shiftPorts
 /******************************************************************************/
-// Illuminate or switch off a group segments on the seven segment display.
-// There are 2 versions of these function, with the choice depending on the
-// location of the current-limiting resistors.
-
-#if RESISTORS==ON_DIGITS
-//For resistors on *digits* we will cycle through all 8 segments (7 + period), turning on the *digits* as appropriate
-//for a given segment, before moving on to the next segment
-#define REFRESH_STEPS  S7_SEGMENTS
-
-void SevSeg::lightsOn(byte segment) {
-	const byte bitmask = 1 << segment;
-    //Turn on all digits
-    for (byte digit=0 ; digit < numDigits ; digit++){
-      if (digitCodes[digit] & bitmask) { // Check a single bit
-        digitalWrite(digitPins[digit], digitOn);
+// Drives the display through a chain of 74HC595 shift registers, instead of
+// pins of its own. Call it before begin(), which then takes the numbers of
+// the shift register outputs instead of pins: 0..7 are the outputs Q0..Q7 of
+// the first register of the chain (the one wired to the Arduino), 8..15 those
+// of the second one, etc. Up to S7_PORTS registers can be used.
+// Each refresh step shifts out one byte per register, then latches them all
+// at once. With 'dataPin' and 'clockPin' on the hardware SPI pins (MOSI and
+// SCK), the bytes are sent by the SPI peripheral, at half the CPU clock, with
+// interrupts disabled for the few microseconds that takes. Otherwise they are
+// sent with shiftOut(), which takes tens of microseconds per register: long
+// enough to lose serial input if interrupts were disabled, so they are not.
+// Then the display must not be refreshed from both an interrupt and the main
+// loop: e.g. stop SevSegTimer before calling clearDisplay().
+
+void SevSegBase::useShiftRegisters(byte latchPinIn, byte dataPinIn,
+                                   byte clockPinIn) {
+  output = S7_OUTPUT_595;
+  latchPin = latchPinIn;
+  dataPin = dataPinIn;
+  clockPin = clockPinIn;
+}
+
+void SevSegBase::beginShiftRegisters() {
+  pinMode(latchPin, OUTPUT);
+  pinMode(dataPin, OUTPUT);
+  pinMode(clockPin, OUTPUT);
+  digitalWrite(latchPin, LOW);
+  digitalWrite(clockPin, LOW);
+#ifdef SPDR
+  useSPI = (dataPin == MOSI && clockPin == SCK);
+  if (useSPI) {
+    pinMode(SS, OUTPUT); // Or the SPI could switch to slave mode
+    SPCR = _BV(SPE) | _BV(MSTR); // Mode 0, MSB first
+    SPSR = _BV(SPI2X);           // F_CPU / 2
+  }
+#endif
+}
+
+void SevSegBase::shiftPorts(const byte values[]) {
+  if (!memcmp(values, portState, numPorts)) return;
+#ifdef SPDR
+  const byte oldSREG = SREG; // Not to be interleaved with an interrupt
+  if (useSPI) cli();
+#endif
+  memcpy(portState, values, numPorts);
+  // The last register of the chain goes first
+  for (byte port = numPorts ; port-- > 0 ; ) {
+    shiftByte(values[port]);
+  }
+  digitalWrite(latchPin, HIGH);
+  digitalWrite(latchPin, LOW);
+#ifdef SPDR
+  SREG = oldSREG;
+#endif
+}
+
+void SevSegBase::shiftByte(byte value) {
+#ifdef SPDR
+  if (useSPI) {
+    SPDR = value;
+    while (!(SPSR & _BV(SPIF))) ;
+    return;
+  }
+#endif
+  shiftOut(dataPin, clockPin, MSBFIRST, value);
+}
+
+
+// useMAX7219, useTM1637 & controllers
+/******************************************************************************/
+// Drives a display through a MAX7219 (or MAX7221) or a TM1637 controller,
+// which does the multiplexing itself. Call one of them before begin(), which
+// then only needs the number of digits: the hardware configuration, pins and
+// resistor location are ignored, and may be 0. The number of digits is
+// limited to 8 on a MAX7219, and 6 on a TM1637.
+// The MAX7219 is wired like a shift register chain (see useShiftRegisters),
+// and shares its use of SPI. Its leftmost digit is DIG(numDigits - 1), as on
+// most modules. The TM1637 takes 2 lines, with pull-up resistors: they are
+// pulled low by making the pins outputs, and released by making them inputs.
+// Its leftmost digit is at address 0.
+// The setters work as usual, and send the controller the digits that changed
+// since the last transmission, and nothing else. The refresh functions have
+// nothing left to do, except switching the display back on after
+// clearDisplay().
+
+#define S7_MAX7219_DIGITS     8
+#define S7_MAX7219_DIGIT0     0x01
+#define S7_MAX7219_DECODE     0x09
+#define S7_MAX7219_INTENSITY  0x0A
+#define S7_MAX7219_SCAN_LIMIT 0x0B
+#define S7_MAX7219_SHUTDOWN   0x0C
+#define S7_MAX7219_TEST       0x0F
+
+#define S7_TM1637_DIGITS      6
+#define S7_TM1637_DATA_FIXED  0x44 // Write to a single address
+#define S7_TM1637_ADDRESS     0xC0
+#define S7_TM1637_DISPLAY     0x80
+#define S7_TM1637_ON          0x08
+#define S7_TM1637_DELAY       5    // Half a clock period (us)
+
+void SevSegBase::useMAX7219(byte loadPin, byte dataPinIn, byte clockPinIn) {
+  output = S7_OUTPUT_MAX7219;
+  latchPin = loadPin;
+  dataPin = dataPinIn;
+  clockPin = clockPinIn;
+}
+
+void SevSegBase::useTM1637(byte dataPinIn, byte clockPinIn) {
+  output = S7_OUTPUT_TM1637;
+  dataPin = dataPinIn;
+  clockPin = clockPinIn;
+}
+
+// Whether the display is driven by a controller, rather than by its own pins
+boolean SevSegBase::isController() {
+  return output == S7_OUTPUT_MAX7219 || output == S7_OUTPUT_TM1637;
+}
+
+void SevSegBase::beginController() {
+  // Only as many digits as the controller has registers for
+  const byte maxControllerDigits = (output == S7_OUTPUT_MAX7219) ?
+                                   S7_MAX7219_DIGITS : S7_TM1637_DIGITS;
+  if (numDigits > maxControllerDigits) numDigits = maxControllerDigits;
+  if (resistors == S7_R_ON_SEGMENTS) numSteps = numDigits;
+
+  // No pins of our own to multiplex
+  numPorts = 0;
+  for (byte digit=0 ; digit < numDigits ; digit++) {
+    digitPort[digit] = digitMask[digit] = 0;
+  }
+  for (byte segment=0 ; segment < S7_SEGMENTS ; segment++) {
+    segmentPort[segment] = segmentMask[segment] = 0;
+  }
+
+  if (output == S7_OUTPUT_MAX7219) {
+    beginShiftRegisters();
+    sendMAX7219(S7_MAX7219_TEST, 0);
+    sendMAX7219(S7_MAX7219_DECODE, 0); // Raw segments
+    sendMAX7219(S7_MAX7219_SCAN_LIMIT, numDigits - 1);
+  }
+  else {
+    // Both lines released, and pulled low whenever they are made outputs
+    pinMode(dataPin, INPUT);
+    pinMode(clockPin, INPUT);
+    digitalWrite(dataPin, LOW);
+    digitalWrite(clockPin, LOW);
+    startTM1637();
+    writeTM1637(S7_TM1637_DATA_FIXED);
+    stopTM1637();
+  }
+  sendAll = true; // The controller holds whatever it held before
+  displayOn = false; // Until the first codes are sent (see begin)
+  sendLevel();
+}
+
+// Sends the digits that changed since they were last sent.
+void SevSegBase::sendCodes() {
+  for (byte digit=0 ; digit < numDigits ; digit++) {
+    const byte code = digitCodes[digit];
+    if (code == sentCodes[digit] && !sendAll) continue;
+    sentCodes[digit] = code;
+    if (output == S7_OUTPUT_MAX7219) {
+      // Segments DP,A..G in bits 7..0
+      byte segments = code & B10000000;
+      for (byte segment=0 ; segment < 7 ; segment++) {
+        if (code & (1 << segment)) segments |= B01000000 >> segment;
       }
+      sendMAX7219(S7_MAX7219_DIGIT0 + numDigits - 1 - digit, segments);
+    }
+    else {
+      startTM1637();
+      writeTM1637(S7_TM1637_ADDRESS + digit);
+      writeTM1637(code); // Same segment order
+      stopTM1637();
     }
-    //Turn on common segment
-    digitalWrite(segmentPins[segment], segmentOn);
+  }
+  sendAll = false;
 }
 
-void SevSeg::lightsOff(byte segment) {
-  //Turn off common segment
-  digitalWrite(segmentPins[segment], segmentOff);
-  //Turn off all digits
-  for (byte digit=0 ; digit < numDigits ; digit++){
-    digitalWrite(digitPins[digit], digitOff);
+// Sends the brightness: 16 levels on a MAX7219, 8 on a TM1637, whose level is
+// part of the display control command.
+void SevSegBase::sendLevel() {
+  if (output == S7_OUTPUT_MAX7219) {
+    sendMAX7219(S7_MAX7219_INTENSITY, duty >> 12);
+  }
+  else if (displayOn) {
+    switchTM1637(true);
   }
 }
-#else  /* RESISTORS==ON_SEGMENTS */
-//For resistors on *segments* we will cycle through all __ # of digits, turning on the *segments* as appropriate
-//for a given digit, before moving on to the next digit
-#define REFRESH_STEPS  numDigits
 
-  void SevSeg::lightsOn(byte digit) {
+void SevSegBase::switchOn() {
+  if (displayOn) return;
+  displayOn = true;
+  if (output == S7_OUTPUT_MAX7219) sendMAX7219(S7_MAX7219_SHUTDOWN, 1);
+  else                             switchTM1637(true);
+}
+
+void SevSegBase::switchOff() {
+  if (!displayOn) return;
+  displayOn = false;
+  if (output == S7_OUTPUT_MAX7219) sendMAX7219(S7_MAX7219_SHUTDOWN, 0);
+  else                             switchTM1637(false);
+}
+
+void SevSegBase::sendMAX7219(byte reg, byte value) {
+  digitalWrite(latchPin, LOW);
+  shiftByte(reg);
+  shiftByte(value);
+  digitalWrite(latchPin, HIGH);
+}
+
+void SevSegBase::switchTM1637(boolean on) {
+  startTM1637();
+  writeTM1637(S7_TM1637_DISPLAY | (on ? S7_TM1637_ON | (duty >> 13) : 0));
+  stopTM1637();
+}
+
+// Bus conditions: data goes low (start) or high (stop) while the clock is high
+void SevSegBase::startTM1637() {
+  pinMode(dataPin, OUTPUT);
+  delayMicroseconds(S7_TM1637_DELAY);
+}
+
+void SevSegBase::stopTM1637() {
+  pinMode(clockPin, OUTPUT);
+  pinMode(dataPin, OUTPUT);
+  delayMicroseconds(S7_TM1637_DELAY);
+  pinMode(clockPin, INPUT);
+  delayMicroseconds(S7_TM1637_DELAY);
+  pinMode(dataPin, INPUT);
+  delayMicroseconds(S7_TM1637_DELAY);
+}
+
+// Sends a byte, LSB first, then clocks the acknowledge bit, which is ignored.
+void SevSegBase::writeTM1637(byte value) {
+  for (byte bit=0 ; bit < 9 ; bit++) {
+    pinMode(clockPin, OUTPUT);
+    // A 1, or the acknowledge bit: release the line
+    pinMode(dataPin, (bit < 8 && !(value & (1 << bit))) ? OUTPUT : INPUT);
+    delayMicroseconds(S7_TM1637_DELAY);
+    pinMode(clockPin, INPUT);
+    delayMicroseconds(S7_TM1637_DELAY);
+  }
+  pinMode(clockPin, OUTPUT);
+}
+
+
+#ifdef S7_CHARLIEPLEX
+// useCharlieplexing
+/******************************************************************************/
+// Drives a charlieplexed display: every pin is both the common pin of a digit
+// and a segment pin of the other digits, and is either driven or left in high
+// impedance. Call it before begin(), with S7_CHARLIEPLEX defined. Segment 's'
+// of digit 'd' is wired to digitPins[s] if s < d, and to segmentPins[s]
+// otherwise; digitPins[d] must be the same pin as segmentPins[d - 1], so that
+// up to 9 digits take 9 pins:
+//   digitPins   = {2, 3, 4, 5}
+//   segmentPins = {3, 4, 5, 6, 7, 8, 9, 10}
+// The display is scanned one digit at a time, whatever 'resistorsIn': put the
+// current-limiting resistors on every pin. Only common cathode and common
+// anode displays can be charlieplexed, without transistors.
+
+void SevSegBase::useCharlieplexing() {
+  output = S7_OUTPUT_CHARLIEPLEX;
+}
+#endif
+
+
+// compileFrames & compileDigit
+/******************************************************************************/
+// Translates 'digitCodes' into 'stepFrames': for each refresh step, the value
+// to write to each port. That way, lightsOn() only has to copy a table to the
+// ports, and all the bit testing happens once per change of 'digitCodes'.
+// The steps are segments or digits, depending on the location of the
+// current-limiting resistors (see begin()).
+// Call compileFrames() after writing 'digitCodes' directly.
+
+void SevSegBase::compileFrames() {
+  numberShown = false; // 'digitCodes' may no longer match 'digitValues'
+  editFrames();
+  if (resistors == S7_R_ON_DIGITS) {
+    //Each step is a bit-plane: the digits showing a segment, mapped to their
+    //pins. Start with all digits off, then light the digits of each plane,
+    //visiting only the segments that are on.
+    for (byte segment=0 ; segment < S7_SEGMENTS ; segment++) {
+      for (byte port=0 ; port < numPorts ; port++) {
+        stepFrames[segment * S7_STEP_SIZE + port] = portOff[port];
+      }
+      //Common segment
+      setStepPin(segment, segmentPort[segment], segmentMask[segment], true);
+    }
+    for (byte digit=0 ; digit < numDigits ; digit++) {
+      byte code = digitCodes[digit];
+      for (byte segment=0 ; code ; segment++, code >>= 1) {
+        if (code & 1) {
+          setStepPin(segment, digitPort[digit], digitMask[digit], true);
+        }
+      }
+    }
+  }
+  else {
+    for (byte digit=0 ; digit < numDigits ; digit++) {
+      compileDigit(digit);
+    }
+  }
+  publishFrames();
+}
+
+void SevSegBase::compileDigit(byte digit) {
   const byte code = digitCodes[digit];
-  //Turn on all segments
-  for (byte segment=0 ; segment < SEGMENTS ; segment++) {
-    if (code & (1 << segment)) { // Check a single bit
-      digitalWrite(segmentPins[segment], segmentOn);
+#ifdef S7_CHARLIEPLEX
+  if (output == S7_OUTPUT_CHARLIEPLEX) {
+    compileCharlieplexed(digit);
+    return;
+  }
+#endif
+  if (resistors == S7_R_ON_DIGITS) {
+    //The digit is lit during the steps of its segments
+    for (byte segment=0 ; segment < S7_SEGMENTS ; segment++) {
+      setStepPin(segment, digitPort[digit], digitMask[digit], code & (1 << segment));
+    }
+  }
+  else {
+    //The digit has a step of its own
+    for (byte port=0 ; port < numPorts ; port++) {
+      stepFrames[digit * S7_STEP_SIZE + port] = portOff[port];
     }
+    for (byte segment=0 ; segment < S7_SEGMENTS ; segment++) {
+      setStepPin(digit, segmentPort[segment], segmentMask[segment], code & (1 << segment));
+    }
+    //Common digit
+    setStepPin(digit, digitPort[digit], digitMask[digit], true);
   }
-  //Turn on common digit
-  digitalWrite(digitPins[digit], digitOn);
 }
-void SevSeg::lightsOff(byte digit) {
-  //Turn off common digit
-  digitalWrite(digitPins[digit], digitOff);
-  //Turn off all segments
-  for (byte segment=0 ; segment < SEGMENTS ; segment++) {
-    digitalWrite(segmentPins[segment], segmentOff);
+
+
+// setStepPin
+/******************************************************************************/
+// Sets whether a pin is lit during a refresh step. A lit pin is simply its
+// 'off' level inverted.
+
+void SevSegBase::setStepPin(byte step, byte port, byte mask, boolean lit) {
+  const byte level = lit ? ~portOff[port] : portOff[port];
+  byte &value = stepFrames[step * S7_STEP_SIZE + port];
+  value = (value & ~mask) | (level & mask);
+}
+
+
+#ifdef S7_CHARLIEPLEX
+// A charlieplexed step drives the digit's common pin and its lit segment pins,
+// each to its 'on' level, and leaves every other pin in high impedance, as any
+// pin driven to a level would light the LEDs between it and the other pins.
+void SevSegBase::compileCharlieplexed(byte digit) {
+  byte *row = stepFrames + digit * S7_STEP_SIZE;
+  for (byte port=0 ; port < numPorts ; port++) {
+    row[port] = 0;
+    row[S7_PORTS + 1 + port] = 0;
+  }
+  const byte code = digitCodes[digit];
+  for (byte segment=0 ; segment < S7_SEGMENTS ; segment++) {
+    if (!(code & (1 << segment))) continue;
+    if (segment < digit) {
+      setLinePin(row, digitPort[segment], digitMask[segment], segmentOn);
+    }
+    else {
+      setLinePin(row, segmentPort[segment], segmentMask[segment], segmentOn);
+    }
   }
+  //Common digit
+  setLinePin(row, digitPort[digit], digitMask[digit], digitOn);
+}
+
+void SevSegBase::setLinePin(byte *row, byte port, byte mask, boolean level) {
+  if (level) row[port] |= mask;
+  row[S7_PORTS + 1 + port] |= mask; // Output
 }
-#endif  /* RESISTORS==ON_SEGMENTS */
+#endif
+
+
+// editFrames, publishFrames & swapFrames
+/******************************************************************************/
+// The frames are a ring of S7_FRAMES slots, so that the display never shows a
+// half updated frame, without having to disable interrupts. The display owns
+// 'front', the slot it shows; the setters own 'back', the slot they write.
+// The slots in between are frames waiting to be shown, oldest first:
+// - editFrames() points 'stepFrames' at the back slot, and makes sure it holds
+//   the latest frame published ('latest'), so that it can be partly updated.
+// - publishFrames() queues the back slot, and moves on to the next one. If the
+//   queue is full, the frame is left pending in the back slot instead.
+// - swapFrames() moves on to the oldest queued frame, or to the pending one
+//   once the queue is empty. It is called at the start of each display frame,
+//   from interrupt context or not.
+// A pending frame is replaced by the next one published, but queued frames
+// are all shown, one per display frame. With 2 slots, there is no room for a
+// queue: the latest frame is simply shown at the next display frame.
+// Each index is only written by one side. The pending frame is the only one
+// both sides may claim: the setters withdraw it before writing the back slot
+// again, and the display takes it by making the back slot its front one (see
+// withdrawPending and takePending).
+
+static inline byte nextSlot(byte slot) {
+  return (slot + 1 < S7_FRAMES) ? slot + 1 : 0;
+}
+
+void SevSegBase::editFrames() {
+  if (pendingLeft && !withdrawPending()) {
+    back = nextSlot(back); // The display took it: move on to a free slot
+  }
+  pendingLeft = false;
+  const unsigned int frameSize = S7_FRAME_SIZE(maxSteps);
+  stepFrames = frames + back * frameSize;
+  if (back != latest) {
+    // The slot holds an old frame: start from the latest one
+    memcpy(stepFrames, frames + latest * frameSize, frameSize);
+  }
+}
+
+void SevSegBase::publishFrames() {
+  // Count the LEDs lit by each step, for stepOnTime(), and list the steps to
+  // scan
+  byte *order = stepFrames + maxSteps * S7_STEP_SIZE;
+  byte length = 0;
+  for (byte step=0 ; step < numSteps ; step++) {
+    byte *row = stepFrames + step * S7_STEP_SIZE;
+    byte lit = 0;
+    for (byte port=0 ; port < numPorts ; port++) {
+      byte bits = row[port] ^ portOff[port];
+#ifdef S7_CHARLIEPLEX
+      if (output == S7_OUTPUT_CHARLIEPLEX) {
+        bits = row[S7_PORTS + 1 + port]; // The pins driven
+      }
+#endif
+      for ( ; bits ; bits &= bits - 1) {
+        lit++;
+      }
+    }
+    row[S7_PORTS] = lit ? lit - 1 : 0; // Not counting the common pin
+    if (row[S7_PORTS] || !skipEmpty) {
+      order[length++] = step;
+    }
+  }
+  scanLength[back] = length;
+  if (minTransitions) {
+    orderScan(order, length);
+  }
+
+  latest = back;
+  S7_BARRIER(); // The frame must be complete before it is shown
+  if (nextSlot(back) != front) {
+    back = nextSlot(back);
+  }
+  else {
+    // Queue full: see swapFrames()
+    pendingLeft = true;
+    framePending = true;
+  }
+
+  if (isController()) {
+    sendCodes();
+  }
+}
+
+// The number of frames published but not shown yet
+byte SevSegBase::framesQueued() {
+  const byte shown = front, written = back;
+  const byte queued = (shown == written) ? 0 :
+                      (written + S7_FRAMES - shown - 1) % S7_FRAMES;
+  return framePending ? queued + 1 : queued;
+}
+
+// Withdraws the pending frame from the display (setters' side). Returns false
+// if the display took it first.
+boolean SevSegBase::withdrawPending() {
+#ifdef HOST_HAL
+  return framePending.exchange(false);
+#else
+  framePending = false; // An interrupt can no longer take it,
+  return front != back; // but may have done so already
+#endif
+}
+
+// Takes the pending frame, if any (display side).
+boolean SevSegBase::takePending() {
+#ifdef HOST_HAL
+  return framePending.exchange(false);
+#else
+  // Not interrupted by the setters
+  const boolean pending = framePending;
+  framePending = false;
+  return pending;
+#endif
+}
+
+// Reorders the scan so that each step differs from the previous one by as few
+// pins as possible (see setMinimalTransitions()). Finding the best order is a
+// travelling salesman problem: the nearest remaining step is taken instead,
+// which is cheap enough to run on every change.
+void SevSegBase::orderScan(byte order[], byte length) {
+  for (byte pos=1 ; pos < length ; pos++) {
+    const byte *last = stepFrames + order[pos - 1] * S7_STEP_SIZE;
+    byte best = pos, bestDistance = 0xFF;
+    for (byte other=pos ; other < length ; other++) {
+      const byte *row = stepFrames + order[other] * S7_STEP_SIZE;
+      byte distance = 0;
+      for (byte port=0 ; port < numPorts ; port++) {
+        byte bits = row[port] ^ last[port];
+#ifdef S7_CHARLIEPLEX
+        bits |= row[S7_PORTS + 1 + port] ^ last[S7_PORTS + 1 + port]; // Modes
+#endif
+        for ( ; bits ; bits &= bits - 1) {
+          distance++;
+        }
+      }
+      if (distance < bestDistance) {
+        best = other;
+        bestDistance = distance;
+      }
+    }
+    const byte step = order[best];
+    order[best] = order[pos];
+    order[pos] = step;
+  }
+}
+
+void SevSegBase::swapFrames() {
+#ifdef HOST_HAL
+  HostHAL::frameStart();
+#endif
+  const byte shown = front, written = back;
+  if (shown != written && nextSlot(shown) != written) {
+    front = nextSlot(shown); // The oldest queued frame
+  }
+  else if (shown != written && takePending()) {
+    front = written; // The setters move on at their next edit
+  }
+}
+
+
+// shownStep, scanOrder, nextStep, stepOnTime & stepDuty
+/******************************************************************************/
+// Each step of a frame is S7_PORTS port values followed by the number of LEDs
+// the step lights, then S7_PORTS pin modes with S7_CHARLIEPLEX. After the
+// steps, each frame lists the steps to scan, in order: the refresh functions
+// play that list, 'scanPos' being the position of the current step in it.
+// Steps that light many LEDs can be given a longer on-time, to make up for the
+// voltage drop on their common pin (see setCompensation()).
+
+const byte *SevSegBase::shownStep(byte step) {
+  return frames + front * S7_FRAME_SIZE(maxSteps) + step * S7_STEP_SIZE;
+}
+
+const byte *SevSegBase::scanOrder() {
+  return shownStep(maxSteps);
+}
+
+// The step to be shown after the current one
+byte SevSegBase::nextStep() {
+  if (!scanLength[front]) return common;
+  const byte pos = scanPos + 1;
+  return scanOrder()[pos < scanLength[front] ? pos : 0];
+}
+
+// The LEDs lit by 'step' beyond the first one
+byte SevSegBase::extraLit(byte step) {
+  const byte lit = shownStep(step)[S7_PORTS];
+  return lit ? lit - 1 : 0;
+}
+
+unsigned int SevSegBase::stepOnTime(byte step) {
+  return ledOnTime +
+         (((unsigned long)ledOnTime * compensation * extraLit(step)) >> 8);
+}
+
+unsigned int SevSegBase::stepDuty(byte step) {
+  const unsigned long scaled = duty +
+         (((unsigned long)duty * compensation * extraLit(step)) >> 8);
+  return scaled < 0xFFFF ? scaled : 0xFFFF;
+}
+
+
+// lightsOn & lightsOff
+/******************************************************************************/
+// Illuminate or switch off a group segments on the seven segment display.
+// lightsOn() goes straight from the pins lit by the previous step (if any) to
+// those of 'step', in two passes: the pins lit by both steps are kept, the
+// others are switched off, then the new ones are switched on. The pins lit by
+// both steps are never a common pin, so no LED is lit in between, and only the
+// pins that differ are written.
+
+void SevSegBase::lightsOn(byte step) {
+#ifdef S7_CHARLIEPLEX
+  if (output == S7_OUTPUT_CHARLIEPLEX) {
+    lightsOnCharlieplexed(step);
+    return;
+  }
+#endif
+  const byte *frame = shownStep(step);
+  if (output != S7_OUTPUT_PINS) {
+    writePorts(frame); // All the outputs change at once
+    return;
+  }
+  for (byte port=0 ; port < numPorts ; port++) {
+    const byte off = portOff[port];
+    writePort(port, off ^ ((portState[port] ^ off) & (frame[port] ^ off)));
+  }
+  for (byte port=0 ; port < numPorts ; port++) {
+    writePort(port, frame[port]);
+  }
+}
+
+void SevSegBase::lightsOff(byte) {
+  //Turn off all digits and segments
+#ifdef S7_CHARLIEPLEX
+  if (output == S7_OUTPUT_CHARLIEPLEX) {
+    for (byte port=0 ; port < numPorts ; port++) {
+      writeMode(port, 0);
+    }
+  }
+#endif
+  writePorts(portOff);
+}
+
+#ifdef S7_CHARLIEPLEX
+// Same two passes with pin modes: the pins driven to the same level by both
+// steps are kept, the others are released. Then the levels of the new step are
+// set while its pins are still inputs (briefly enabling pull-ups on those that
+// go high), and they are made outputs.
+void SevSegBase::lightsOnCharlieplexed(byte step) {
+  const byte *frame = shownStep(step);
+  const byte *modes = frame + S7_PORTS + 1;
+  for (byte port=0 ; port < numPorts ; port++) {
+    const byte kept = modeState[port] & modes[port] &
+                      ~(portState[port] ^ frame[port]);
+    writeMode(port, kept);
+    writePort(port, frame[port] & kept);
+  }
+  for (byte port=0 ; port < numPorts ; port++) {
+    writePort(port, frame[port]);
+    writeMode(port, modes[port]);
+  }
+}
+#endif
 
 
 // refreshDisplay
@@ -191,12 +1134,45 @@ void SevSeg::lightsOff(byte digit) {
 // This is achieved by cycling through all segments and digits, turning the
 // required segments on as specified by the array 'digitCodes'.
 
-void SevSeg::refreshDisplay(){
-  for (byte step = 0; step < REFRESH_STEPS; step++) {
+void SevSegBase::refreshDisplay(){
+  if (isController()) {
+    switchOn(); // The controller does the rest
+    return;
+  }
+  swapFrames();
+  const byte *order = scanOrder();
+  for (byte pos = 0; pos < scanLength[front]; pos++) {
+    const byte step = order[pos];
     lightsOn(step);
     //Wait with lights on (to increase brightness)
-    delayMicroseconds(ledOnTime);
-    lightsOff(step);
+    delayMicroseconds(stepOnTime(step));
+  }
+  lightsOff(common);
+}
+
+
+// pollDisplay
+/******************************************************************************/
+// Non-blocking version of refreshDisplay(): each step gets a slot of
+// S7_POLL_SLOT microseconds, the time it stays lit at full brightness. The
+// step is switched off once it has been lit for its part of the slot (see
+// stepDuty()), and the next one is lit when the slot is over, just as
+// SevSegTimer does. Returns immediately otherwise.
+// Must be called repeatedly: the on-time is only as precise as the time
+// between calls, so the lowest brightness levels need frequent calls.
+
+#define S7_POLL_SLOT 2000UL
+
+void SevSegBase::pollDisplay(){
+  const unsigned long now = micros();
+  if (now - stepStart >= S7_POLL_SLOT) {
+    stepStart = now;
+    updateDisplay();
+    return;
+  }
+  const unsigned int litPart = stepDuty(common);
+  if (litPart != 0xFFFF && now - stepStart >= (S7_POLL_SLOT * litPart) >> 16) {
+    lightsOff(common); // Until the slot is over
   }
 }
 
@@ -207,12 +1183,72 @@ void SevSeg::refreshDisplay(){
 // Meant to be called from interrupt context, to offload display updates to a
 // hardware timer.
 
-void SevSeg::updateDisplay(){
-  lightsOff(common);
-  if (++common == REFRESH_STEPS) {
-	  common = 0;
+void SevSegBase::updateDisplay(){
+  if (isController()) {
+    switchOn();
+    return;
+  }
+  if (++scanPos >= scanLength[front]) {
+	  scanPos = 0;
+	  swapFrames(); // A new frame starts
+  }
+  if (scanLength[front]) {
+	  common = scanOrder()[scanPos];
+	  lightsOn(common);
+  }
+  else {
+	  lightsOff(common);
   }
-  lightsOn(common);
+}
+
+
+// updateDisplayBCM & lightsOnPlane
+/******************************************************************************/
+// Binary code modulation: each step is shown S7_BCM_BITS times, once per
+// bit-plane of the digit brightness levels. Plane 'n' lights only the digits
+// whose level has that bit set, and must stay lit twice as long as plane
+// 'n - 1'. updateDisplayBCM() moves on to the next plane (and to the next step
+// after the last plane), and returns the plane number: the caller must wait
+// 2^plane time units before calling it again. See SevSegTimer::beginBCM().
+
+byte SevSegBase::updateDisplayBCM(){
+  if (isController()) {
+    switchOn();
+    return 0;
+  }
+  if (++plane >= S7_BCM_BITS) {
+    plane = 0;
+    lightsOff(common);
+    if (++scanPos >= scanLength[front]) {
+      scanPos = 0;
+      swapFrames(); // A new frame starts
+    }
+    if (!scanLength[front]) return plane; // Nothing to show
+    common = scanOrder()[scanPos];
+  }
+  lightsOnPlane(common, plane);
+  return plane;
+}
+
+// Within a step, the lit pins can only go from one plane's subset to the
+// next, so each port is written directly, without switching off in between.
+void SevSegBase::lightsOnPlane(byte step, byte bit) {
+#ifdef S7_CHARLIEPLEX
+  if (output == S7_OUTPUT_CHARLIEPLEX) {
+    // Its pin is also a segment of other digits: each step is a digit, which is
+    // lit or not as a whole
+    if (planeMask[bit][digitPort[step]] & digitMask[step]) lightsOn(step);
+    else                                                   lightsOff(step);
+    return;
+  }
+#endif
+  const byte *frame = shownStep(step);
+  const byte *mask = planeMask[bit];
+  byte values[S7_PORTS];
+  for (byte port=0 ; port < numPorts ; port++) {
+    values[port] = portOff[port] ^ ((frame[port] ^ portOff[port]) & mask[port]);
+  }
+  writePorts(values);
 }
 
 
@@ -222,24 +1258,101 @@ void SevSeg::updateDisplay(){
 // Necessary with interrupt-driven display (see: updateDisplay()), to make sure
 // all segments are off during a POWER_DOWN, for example.
 
-void SevSeg::clearDisplay(){
-  //Turn off all digits
-  for (byte digit=0 ; digit < numDigits ; digit++){
-	digitalWrite(digitPins[digit], digitOff);
+void SevSegBase::clearDisplay(){
+  if (isController()) {
+    switchOff();
+    return;
   }
-  //Turn off all segments
-  for (byte segment=0 ; segment < S7_SEGMENTS ; segment++) {
-	digitalWrite(segmentPins[segment], segmentOff);
+  lightsOff(common);
+}
+
+
+// setBrightness & setBrightnessLevel
+/******************************************************************************/
+// The eye is far more sensitive to changes at low light levels, so the
+// brightness goes through a gamma curve (see 'gammaTable') before being
+// turned into an LED on-time. setBrightness() takes 0..100, and
+// setBrightnessLevel() the full 0..255 range, for finer steps.
+// The on-time never drops below 1us (refreshDisplay) or 1/65535 of a step's
+// slot (SevSegTimer and pollDisplay), so 0 is dim but not off.
+
+void SevSegBase::setBrightness(int brightness){
+  brightness = constrain(brightness, 0, 100);
+  setBrightnessLevel(map(brightness, 0, 100, 0, 255));
+}
+
+void SevSegBase::setBrightnessLevel(byte level){
+  const unsigned int linear = pgm_read_word(&gammaTable[level]);
+  ledOnTime = map(linear, 0, 0xFFFF, 1, 2000);
+  const unsigned int oldDuty = duty;
+  duty = linear ? linear : 1;
+  if (isController() && numDigits && duty != oldDuty) {
+    sendLevel();
   }
 }
 
 
-// setBrightness
+// setCompensation
 /******************************************************************************/
+// Lengthens the on-time of the steps that light several LEDs at once, as they
+// share a single common pin and look dimmer otherwise. Each LED beyond the
+// first adds 'perLed'/256 of the on-time: e.g. 16 makes a step lighting all 8
+// segments of a digit last 7 x 16/256 = 44% longer than a step lighting one.
+// 0, the default, disables the compensation.
+
+void SevSegBase::setCompensation(byte perLed){
+  compensation = perLed;
+}
 
-void SevSeg::setBrightness(int brightness){
-  brightness = constrain(brightness, 0, 100);
-  ledOnTime = map(brightness, 0, 100, 1, 2000);
+
+// setSkipEmptySteps
+/******************************************************************************/
+// By default, the steps that light nothing (e.g. the decimal point segment
+// when no decimal point is shown, or the blank leading digits) are left out of
+// the scan, so that the lit ones come around more often. Pass false to scan
+// every step, e.g. to keep a constant frame rate whatever is shown.
+
+void SevSegBase::setSkipEmptySteps(boolean skip){
+  skipEmpty = skip;
+  editFrames();
+  publishFrames();
+}
+
+
+// setMinimalTransitions
+/******************************************************************************/
+// Pass true to scan the steps in the order that changes the fewest pins from
+// one step to the next, rather than in pin order. The order is worked out
+// again whenever the number shown changes. Fewer pin changes mean shorter
+// updates, and less interference from long cables to the display.
+
+void SevSegBase::setMinimalTransitions(boolean minimal){
+  minTransitions = minimal;
+  editFrames();
+  publishFrames();
+}
+
+
+// setDigitBrightness
+/******************************************************************************/
+// Sets the brightness of a single digit, from 0 (off) to 255 (full), on the
+// same gamma curve as setBrightnessLevel(). Only takes effect when the display
+// is driven by updateDisplayBCM(). With fewer than 8 S7_BCM_BITS, the
+// corrected level loses its least significant bits.
+
+void SevSegBase::setDigitBrightness(byte digit, byte level){
+  if (digit >= numDigits) return;
+
+  const byte linear = pgm_read_word(&gammaTable[level]) >> 8;
+  const byte port = digitPort[digit];
+  for (byte bit=0 ; bit < S7_BCM_BITS ; bit++) {
+    if (linear & (1 << (8 - S7_BCM_BITS + bit))) {
+      planeMask[bit][port] |= digitMask[digit];
+    }
+    else {
+      planeMask[bit][port] &= ~digitMask[digit];
+    }
+  }
 }
 
 
@@ -249,43 +1362,85 @@ void SevSeg::setBrightness(int brightness){
 // It is overloaded for all number data types, so that floats can be handled
 // correctly.
 
-void SevSeg::setNumber(long numToShow, byte decPlaces) //long
+void SevSegBase::setNumber(long numToShow, byte decPlaces) //long
 {
   setNewNum(numToShow, decPlaces);
 }
 
-void SevSeg::setNumber(unsigned long numToShow, byte decPlaces) //unsigned long
+void SevSegBase::setNumber(unsigned long numToShow, byte decPlaces) //unsigned long
 {
   setNewNum(numToShow, decPlaces);
 }
 
-void SevSeg::setNumber(int numToShow, byte decPlaces) //int
+void SevSegBase::setNumber(int numToShow, byte decPlaces) //int
 {
   setNewNum(numToShow, decPlaces);
 }
 
-void SevSeg::setNumber(unsigned int numToShow, byte decPlaces) //unsigned int
+void SevSegBase::setNumber(unsigned int numToShow, byte decPlaces) //unsigned int
 {
   setNewNum(numToShow, decPlaces);
 }
 
-void SevSeg::setNumber(char numToShow, byte decPlaces) //char
+void SevSegBase::setNumber(char numToShow, byte decPlaces) //char
 {
   setNewNum(numToShow, decPlaces);
 }
 
-void SevSeg::setNumber(byte numToShow, byte decPlaces) //byte
+void SevSegBase::setNumber(byte numToShow, byte decPlaces) //byte
 {
   setNewNum(numToShow, decPlaces);
 }
 
-void SevSeg::setNumber(float numToShow, byte decPlaces) //float
+#ifndef S7_NO_FLOAT
+void SevSegBase::setNumber(float numToShow, byte decPlaces) //float
 {
   numToShow = numToShow * powersOf10[decPlaces];
   // Modify the number so that it is rounded to an integer correctly
   numToShow += (numToShow >= 0) ? 0.5f : -0.5f;
   setNewNum(numToShow, decPlaces);
 }
+#endif
+
+
+// setNumberFixed
+/******************************************************************************/
+// Displays a fixed-point number, with 'fracBits' fractional bits (e.g. 16 for
+// a Q16.16 number), rounded to 'decPlaces' decimal places. 'fracBits' goes
+// from 0 to 31: larger values are taken as 31.
+// This is the integer-only alternative to setNumber(float): the decimal places
+// are produced one at a time by multiplying the fractional part by 10. So that
+// this fits in 32 bits, only the top 28 bits of the fractional part are used.
+
+void SevSegBase::setNumberFixed(long numToShow, byte fracBits, byte decPlaces)
+{
+  if (fracBits > 31) fracBits = 31;
+  const boolean negative = numToShow < 0;
+  const unsigned long magnitude = negative ? -(unsigned long)numToShow : numToShow;
+  unsigned long frac = magnitude & ((1UL << fracBits) - 1);
+  long scaled = magnitude >> fracBits;
+  if (fracBits > 28) {
+    frac >>= fracBits - 28;
+    fracBits = 28;
+  }
+  const unsigned long fracMask = (1UL << fracBits) - 1;
+
+  for (byte place = 0 ; place < decPlaces ; place++) {
+    if (scaled >= powersOf10[8]) { // Too large to display: show dashes
+      scaled = powersOf10[9];
+      break;
+    }
+    frac *= 10;
+    scaled = scaled * 10 + (frac >> fracBits);
+    frac &= fracMask;
+  }
+
+  // Round to the nearest, halves away from zero as with floats
+  if (fracBits && (frac >> (fracBits - 1))) {
+    scaled++;
+  }
+  setNewNum(negative ? -scaled : scaled, decPlaces);
+}
 
 
 // setSegments
@@ -305,11 +1460,14 @@ void SevSeg::setNumber(float numToShow, byte decPlaces) //float
 //                       E    C        4    2        (Segment H is often called
 //                        DDDD  H       3333  7      DP, for Decimal Point)
 
-void SevSeg::setSegments(byte segs[])
+void SevSegBase::setSegments(byte segs[])
 {
+  byte changes = 0;
   for (byte digit = 0; digit < numDigits; digit++) {
-	  digitCodes[digit] = segs[digit];
+	  setCode(digit, segs[digit], changes);
   }
+  publishCodes(changes);
+  numberShown = false;
 }
 
 
@@ -317,10 +1475,13 @@ void SevSeg::setSegments(byte segs[])
 /******************************************************************************/
 // Same as setSegments() with a PROGMEM pointer.
 
-void SevSeg::setSegmentsPGM(const byte *segs) {
+void SevSegBase::setSegmentsPGM(const byte *segs) {
+  byte changes = 0;
   for (byte digit = 0; digit < numDigits; digit++) {
-    digitCodes[digit] = pgm_read_byte(segs++);
+    setCode(digit, pgm_read_byte(segs++), changes);
   }
+  publishCodes(changes);
+  numberShown = false;
 }
 
 
@@ -328,10 +1489,91 @@ void SevSeg::setSegmentsPGM(const byte *segs) {
 /******************************************************************************/
 // Changes the number that will be displayed.
 
-void SevSeg::setNewNum(long numToShow, byte decPlaces){
-  byte digits[numDigits];
-  findDigits(numToShow, decPlaces, digits);
-  setDigitCodes(digits, decPlaces);
+// Nothing is done if the same number is already shown: the digits are only
+// converted when it changes, and then only the digits that change are
+// recompiled (see setCode()). 'conversions' and 'skippedConversions' count
+// both cases.
+
+void SevSegBase::setNewNum(long numToShow, byte decPlaces){
+  if (numberShown && numToShow == number && decPlaces == numberDecPlaces) {
+    skippedConversions++;
+    return;
+  }
+  conversions++;
+  findDigits(numToShow, decPlaces, digitValues);
+  setDigitCodes(digitValues, decPlaces);
+  number = numToShow;
+  numberDecPlaces = decPlaces;
+  numberShown = true;
+}
+
+
+// increment, decrement & add
+/******************************************************************************/
+// Add to the number shown with setNumber(), in units of its last digit (e.g.
+// increment() goes from 1.5 to 1.6 with 1 decimal place). Only the digits
+// that change are updated: counting up or down by one is a carry over the
+// digits, which takes a single digit 9 times out of 10. Negative or out of
+// range results, or a display set with setSegments(), go through setNumber().
+
+void SevSegBase::increment() {
+  add(1);
+}
+
+void SevSegBase::decrement() {
+  add(-1);
+}
+
+void SevSegBase::add(long amount) {
+  const long result = number + amount;
+  if (!numberShown || number < 0 || number >= powersOf10[numDigits] ||
+      result < 0 || result >= powersOf10[numDigits]) {
+    setNewNum(result, numberDecPlaces);
+    return;
+  }
+
+  byte changes = 0;
+  if (amount == 1 || amount == -1) {
+    // Ripple the carry from the last digit
+    const boolean up = amount == 1;
+    byte digit = numDigits;
+    byte value;
+    do {
+      digit--;
+      value = digitValues[digit];
+      if (value == BLANK) value = 0;
+      if (up) value = (value == 9) ? 0 : value + 1;
+      else    value = (value == 0) ? 9 : value - 1;
+      setDigit(digit, value, changes);
+    } while (value == (up ? 0 : 9) && digit > 0);
+
+    // Counting down may leave a new leading zero
+    if (!up && value == 0 && digit < numDigits - 1 - numberDecPlaces &&
+        (digit == 0 || digitValues[digit - 1] == BLANK)) {
+      setDigit(digit, BLANK, changes);
+    }
+  }
+  else {
+    byte digits[numDigits];
+    findDigits(result, numberDecPlaces, digits);
+    for (byte digit = 0 ; digit < numDigits ; digit++) {
+      if (digits[digit] != digitValues[digit]) {
+        setDigit(digit, digits[digit], changes);
+      }
+    }
+  }
+  number = result;
+  publishCodes(changes);
+}
+
+// Shows 'value' (a number, BLANK or DASH) on a digit (see setCode()).
+void SevSegBase::setDigit(byte digit, byte value, byte &changes) {
+  digitValues[digit] = value;
+  byte code = digitCodeMap[value];
+  if (digit == numDigits - 1 - numberDecPlaces) {
+    code |= B10000000;
+  }
+  setCode(digit, code, changes);
 }
 
 
@@ -340,9 +1582,9 @@ void SevSeg::setNewNum(long numToShow, byte decPlaces){
 // Decides what each digit will display.
 // Enforces the upper and lower limits on the number to be displayed.
 
-void SevSeg::findDigits(long numToShow, byte decPlaces, byte digits[]) {
-  static const long maxNum = powersOf10[numDigits] - 1;
-  static const long minNum = -(powersOf10[numDigits - 1] - 1);
+void SevSegBase::findDigits(long numToShow, byte decPlaces, byte digits[]) {
+  const long maxNum = powersOf10[numDigits] - 1;
+  const long minNum = -(powersOf10[numDigits - 1] - 1);
 
   // If the number is out of range, just display dashes
   if (numToShow > maxNum || numToShow < minNum) {
@@ -361,11 +1603,16 @@ void SevSeg::findDigits(long numToShow, byte decPlaces, byte digits[]) {
     }
 
     // Find all digits for the base 10 representation, starting with the most
-    // significant digit
+    // significant digit. Each digit is found by repeated subtraction (at most
+    // 9 per digit), which is much cheaper than a long division on an AVR.
     for ( ; digitNum < numDigits ; digitNum++){
-      long factor = powersOf10[numDigits - 1 - digitNum];
-      digits[digitNum] = numToShow / factor;
-      numToShow -= digits[digitNum] * factor;
+      const long factor = powersOf10[numDigits - 1 - digitNum];
+      byte digit = 0;
+      while (numToShow >= factor) {
+        numToShow -= factor;
+        digit++;
+      }
+      digits[digitNum] = digit;
     }
 
     // Find unnnecessary leading zeros and set them to BLANK
@@ -387,35 +1634,70 @@ void SevSeg::findDigits(long numToShow, byte decPlaces, byte digits[]) {
 /******************************************************************************/
 // Sets the 'digitCodes' that are required to display the input numbers
 
-void SevSeg::setDigitCodes(byte digits[], byte decPlaces) {
-
-  // The codes below indicate which segments must be illuminated to display
-  // each number.
-  static const byte digitCodeMap[] = {
-  // Segments:    [see setSegments() for bit/segment mapping]
-  // HGFEDCBA  // Char:
-    B00111111, // 0
-    B00000110, // 1
-    B01011011, // 2
-    B01001111, // 3
-    B01100110, // 4
-    B01101101, // 5
-    B01111101, // 6
-    B00000111, // 7
-    B01111111, // 8
-    B01101111, // 9
-    B00000000, // BLANK
-    B01000000, // DASH
-  };
-
+void SevSegBase::setDigitCodes(byte digits[], byte decPlaces) {
   // Set the digitCode for each digit in the display
+  byte changes = 0;
   for (byte digitNum = 0 ; digitNum < numDigits ; digitNum++) {
-    digitCodes[digitNum] = digitCodeMap[digits[digitNum]];
+    byte code = digitCodeMap[digits[digitNum]];
     // Set the decimal place segment
     if (digitNum == numDigits - 1 - decPlaces) {
-     digitCodes[digitNum] |= B10000000;
+     code |= B10000000;
     }
+    setCode(digitNum, code, changes);
+  }
+  publishCodes(changes);
+}
+
+
+// setCode & publishCodes
+/******************************************************************************/
+// Sets the code of a digit, and recompiles the digit only if the code changed.
+// 'changes' counts the digits changed so far: the frames are opened for
+// editing on the first one, and publishCodes() must be called once all are
+// set.
+// 'codesSequence' is odd while 'digitCodes' is being written, and changes with
+// each update, for readDigitCodes().
+
+void SevSegBase::setCode(byte digit, byte code, byte &changes) {
+  if (digitCodes[digit] == code) return;
+  if (!changes++) {
+    editFrames();
+    codesSequence++;
+    S7_BARRIER();
   }
+  digitCodes[digit] = code;
+  compileDigit(digit);
+}
+
+void SevSegBase::publishCodes(byte changes) {
+  if (!changes) return;
+  S7_BARRIER();
+  codesSequence++;
+  publishFrames();
+}
+
+
+// readDigitCodes
+/******************************************************************************/
+// Copies 'digitCodes' into 'codes' (one byte per digit), as a whole: if the
+// setters change them during the copy (e.g. from an interrupt), the copy is
+// started again. The setters never wait for readers.
+// Do not call it from an interrupt that may interrupt a setter: it would wait
+// forever for the setter to finish. After 128 updates during a single copy,
+// a change could go unnoticed.
+
+void SevSegBase::readDigitCodes(byte codes[]) {
+  S7SequenceValue before;
+  do {
+    do {
+      before = codesSequence;
+    } while (before & 1); // Being written
+    S7_BARRIER();
+    for (byte digit = 0 ; digit < numDigits ; digit++) {
+      codes[digit] = digitCodes[digit];
+    }
+    S7_BARRIER();
+  } while (codesSequence != before);
 }
 
 /// END ///
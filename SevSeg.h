@@ -24,16 +24,25 @@
 #define S7_R_ON_DIGITS    0
 #define S7_R_ON_SEGMENTS  1
 // If you use current-limiting resistors on your segment pins instead of the
-// digit pins, set S7_RESISTORS to S7_R_ON_SEGMENTS.
+// digit pins, set S7_RESISTORS to S7_R_ON_SEGMENTS, or pass S7_R_ON_SEGMENTS
+// to SevSeg::begin().
 #ifndef S7_RESISTORS
 #define S7_RESISTORS   S7_R_ON_DIGITS
 #endif
 #ifndef S7_DIGITS
 #define S7_DIGITS      3 //Increase this number to support larger displays
 #endif
+// Define S7_NO_FLOAT to remove setNumber(float), and make sure the floating
+// point library is never pulled in by accident. Use setNumberFixed() instead.
+//#define S7_NO_FLOAT
+// Define S7_CHARLIEPLEX to support charlieplexed displays (see
+// useCharlieplexing()). Each refresh step then also holds the pin modes.
+//#define S7_CHARLIEPLEX
 #ifndef S7_SEGMENTS
 #define S7_SEGMENTS    8
 #endif
+// The number of refresh steps: one per segment or one per digit
+#define S7_STEPS       (S7_DIGITS > S7_SEGMENTS ? S7_DIGITS : S7_SEGMENTS)
 
 
 #ifndef SevSeg_h
@@ -53,18 +62,119 @@
 #define S7_NP_COMMON_CATHODE  1
 #define S7_NP_COMMON_ANODE    0
 
+// What drives the digits and segments (see useShiftRegisters(), useMAX7219()
+// and useTM1637())
+#define S7_OUTPUT_PINS        0
+#define S7_OUTPUT_595         1
+#define S7_OUTPUT_MAX7219     2
+#define S7_OUTPUT_TM1637      3
+#define S7_OUTPUT_CHARLIEPLEX 4
 
-class SevSeg
+// On AVR, the pins are driven by writing their PORTx registers directly, with
+// all the pins of a port updated at once. Elsewhere, pins are grouped into
+// 'virtual' ports of 8, written bit by bit with digitalWrite().
+#if defined(__AVR__) || defined(HOST_HAL)
+#define S7_PORT_IO
+#ifdef HOST_HAL
+typedef volatile HostHAL::Register S7PortReg;
+#else
+typedef volatile uint8_t S7PortReg;
+#endif
+#endif
+
+// The frame slots are shared between the setters and the refresh functions,
+// which may run from an interrupt (see editFrames). Single bytes are atomic on
+// AVR. On a host, the two sides may be threads.
+// S7_BARRIER() keeps the compiler (and a host CPU) from moving memory accesses
+// across it.
+#ifdef HOST_HAL
+#include <atomic>
+typedef std::atomic<byte>    S7Slot;
+typedef std::atomic<boolean> S7Flag;
+typedef unsigned int         S7SequenceValue;
+typedef std::atomic<S7SequenceValue> S7Sequence;
+#define S7_BARRIER()  std::atomic_thread_fence(std::memory_order_seq_cst)
+#else
+typedef volatile byte    S7Slot;
+typedef volatile boolean S7Flag;
+typedef byte             S7SequenceValue;
+typedef volatile byte    S7Sequence;
+#define S7_BARRIER()  __asm__ __volatile__ ("" ::: "memory")
+#endif
+
+// Number of frame slots. With more than 2, the frames set faster than they
+// can be shown are queued, and shown one per display frame (see editFrames).
+#ifndef S7_FRAMES
+#define S7_FRAMES      2
+#endif
+
+// Number of bit-planes of the per-digit brightness (see setDigitBrightness()):
+// 8 gives 256 levels. Each bit less halves the frame time with SevSegTimer.
+#ifndef S7_BCM_BITS
+#define S7_BCM_BITS    8
+#endif
+
+// The maximum number of I/O ports the digit and segment pins may be spread
+// over. By default, enough for any pins of the board (3 on an Uno, up to 11 on
+// a Mega), but no more than one port per pin. It may be lowered to save RAM.
+// If the pins need more ports, they are all driven with digitalWrite() instead,
+// in 'virtual' ports of 8 pins (see resolvePin()), which needs at least
+// S7_PIN_PORTS.
+#define S7_PIN_PORTS   ((S7_DIGITS + S7_SEGMENTS + 7) / 8)
+#ifndef S7_PORTS
+#ifdef S7_PORT_IO
+#if defined(HOST_HAL)
+#define S7_IO_PORTS    HOST_PORTS
+#elif defined(PORTL)
+#define S7_IO_PORTS    11 // PORTA..PORTL, e.g. ATmega2560
+#elif defined(PORTF)
+#define S7_IO_PORTS    6  // e.g. ATmega32U4 (Leonardo)
+#elif defined(PORTA)
+#define S7_IO_PORTS    4  // e.g. ATmega1284
+#else
+#define S7_IO_PORTS    3  // PORTB..PORTD, e.g. ATmega328P (Uno)
+#endif
+#if S7_IO_PORTS > S7_DIGITS + S7_SEGMENTS
+#define S7_PORTS       (S7_DIGITS + S7_SEGMENTS)
+#elif S7_IO_PORTS < S7_PIN_PORTS
+#define S7_PORTS       S7_PIN_PORTS
+#else
+#define S7_PORTS       S7_IO_PORTS
+#endif
+#else
+#define S7_PORTS       S7_PIN_PORTS
+#endif
+#endif
+
+
+// Storage needed by a display of 'd' digits, scanned in 's' refresh steps
+#ifdef S7_CHARLIEPLEX
+#define S7_STEP_MODES     S7_PORTS // Pin modes, after the port values
+#else
+#define S7_STEP_MODES     0
+#endif
+#define S7_DIGIT_DATA(d)  (6 * (d))
+#define S7_STEP_SIZE      (S7_PORTS + 1 + S7_STEP_MODES)
+#define S7_FRAME_SIZE(s)  ((s) * (S7_STEP_SIZE + 1)) // Steps, and scan order
+#define S7_FRAME_DATA(s)  (S7_FRAMES * S7_FRAME_SIZE(s))
+
+
+// SevSegBase holds all the logic, but no storage: it is given its arrays by
+// the classes below, sized either for S7_DIGITS or for a given display.
+class SevSegBase
 {
 public:
-  SevSeg();
-
   void refreshDisplay();
+  void pollDisplay();
   void updateDisplay();
   void clearDisplay();
-  void begin(const byte hardwareConfig, const byte numDigitsIn,
-             const byte digitPinsIn[],  const byte segmentPinsIn[]);
   void setBrightness(int brightnessIn); // A number from 0..100
+  void setBrightnessLevel(byte level); // A number from 0..255
+  void setCompensation(byte perLed);
+  void setSkipEmptySteps(boolean skip);
+  void setMinimalTransitions(boolean minimal);
+  void setDigitBrightness(byte digit, byte level); // A number from 0..255
+  byte updateDisplayBCM();
 
   void setNumber(long numToShow, byte decPlaces);
   void setNumber(unsigned long numToShow, byte decPlaces);
@@ -72,28 +182,192 @@ public:
   void setNumber(unsigned int numToShow, byte decPlaces);
   void setNumber(char numToShow, byte decPlaces);
   void setNumber(byte numToShow, byte decPlaces);
+#ifndef S7_NO_FLOAT
   void setNumber(float numToShow, byte decPlaces);
+#endif
+  void setNumberFixed(long numToShow, byte fracBits, byte decPlaces);
+  void increment();
+  void decrement();
+  void add(long amount);
 
   void setSegments(byte segs[]);
   void setSegmentsPGM(const byte *segs);
+  void compileFrames();
+  byte framesQueued();
+  void useShiftRegisters(byte latchPin, byte dataPin, byte clockPin);
+  void useMAX7219(byte loadPin, byte dataPin, byte clockPin);
+  void useTM1637(byte dataPin, byte clockPin);
+#ifdef S7_CHARLIEPLEX
+  void useCharlieplexing();
+#endif
 
-  byte digitCodes[S7_DIGITS];
+  byte *const digitCodes;
+  void readDigitCodes(byte codes[]);
+  // Calls of setNumber() that converted the number, and those skipped as the
+  // number was already shown
+  unsigned int conversions, skippedConversions;
+
+protected:
+  SevSegBase(byte maxDigitsIn, byte maxStepsIn,
+             byte digitData[], byte frameData[]);
+  void begin(const byte hardwareConfig, const byte numDigitsIn,
+             const byte digitPinsIn[],  const byte segmentPinsIn[],
+             const byte resistorsIn);
 
 private:
   void lightsOn(byte current);
   void lightsOff(byte current);
+  void lightsOnPlane(byte current, byte bit);
+#ifdef S7_CHARLIEPLEX
+  void lightsOnCharlieplexed(byte current);
+  void compileCharlieplexed(byte digit);
+  void setLinePin(byte *row, byte port, byte mask, boolean level);
+  void writeMode(byte port, byte value);
+#endif
+  const byte *shownStep(byte step);
+  const byte *scanOrder();
+  byte nextStep();
+  byte extraLit(byte step);
+  unsigned int stepOnTime(byte step);
+  unsigned int stepDuty(byte step);
+  void compileDigit(byte digit);
+  void setStepPin(byte step, byte port, byte mask, boolean lit);
+  void editFrames();
+  void publishFrames();
+  void orderScan(byte order[], byte length);
+  void swapFrames();
+  boolean withdrawPending();
+  boolean takePending();
+  void beginPins(const byte digitPinsIn[], const byte segmentPinsIn[]);
+  void resolvePins();
+  void resolvePin(byte pin, byte index, boolean offLevel,
+                  byte &port, byte &mask);
+  void writePort(byte port, byte value);
+  void writePorts(const byte values[]);
+  void beginShiftRegisters();
+  void shiftPorts(const byte values[]);
+  void shiftByte(byte value);
+  boolean isController();
+  void beginController();
+  void sendCodes();
+  void sendLevel();
+  void switchOn();
+  void switchOff();
+  void sendMAX7219(byte reg, byte value);
+  void switchTM1637(boolean on);
+  void startTM1637();
+  void stopTM1637();
+  void writeTM1637(byte value);
   void setNewNum(long numToShow, byte decPlaces);
   void findDigits(long numToShow, byte decPlaces, byte nums[]);
   void setDigitCodes(byte nums[], byte decPlaces);
+  void setDigit(byte digit, byte value, byte &changes);
+  void setCode(byte digit, byte code, byte &changes);
+  void publishCodes(byte changes);
 
+  const byte maxDigits, maxSteps;
   boolean digitOn,digitOff,segmentOn,segmentOff;
-  byte digitPins[S7_DIGITS];
+  byte resistors; // S7_R_ON_DIGITS or S7_R_ON_SEGMENTS
+  byte output;    // S7_OUTPUT_PINS, S7_OUTPUT_595, etc.
+  byte latchPin, dataPin, clockPin; // Shift registers or controller
+#ifdef SPDR
+  boolean useSPI;
+#endif
+  byte *const digitPins;
+  byte *const digitPort, *const digitMask;
+  byte *const digitValues; // What each digit shows: 0..9, BLANK or DASH
+  byte *const sentCodes;   // The codes last sent to a controller
+  boolean sendAll;         // The controller needs every code (see sendCodes)
+  boolean displayOn;       // The controller is switched on
+  long number;             // The number they show, when 'numberShown'
+  byte numberDecPlaces;
+  boolean numberShown;
+  S7Sequence codesSequence; // See readDigitCodes()
   byte segmentPins[S7_SEGMENTS];
+  byte segmentPort[S7_SEGMENTS], segmentMask[S7_SEGMENTS];
+#ifdef S7_PORT_IO
+  boolean portIO; // The pins fit in S7_PORTS ports (see resolvePin)
+  S7PortReg *portReg[S7_PORTS];
+#endif
+  byte portMask[S7_PORTS]; // Bits of each port used by the display
+  byte portOff[S7_PORTS];  // Their levels when the display is off
+  byte portState[S7_PORTS]; // Their levels last written (see writePort)
+#ifdef S7_CHARLIEPLEX
+#ifdef S7_PORT_IO
+  S7PortReg *modeReg[S7_PORTS];
+#endif
+  byte modeState[S7_PORTS]; // Their modes last written (see writeMode)
+#endif
+  byte planeMask[S7_BCM_BITS][S7_PORTS]; // Bits that may be lit in each plane
+  byte plane; // Current bit-plane (see updateDisplayBCM)
+  // Port values for each refresh step, S7_STEP_SIZE bytes per step. There are
+  // S7_FRAMES frames: the front one is being displayed, the back one
+  // ('stepFrames') is written by the setters.
+  byte *const frames;
+  byte *stepFrames;
+  S7Slot front, back;
+  S7Flag framePending; // The back frame is ready to be displayed
+  boolean pendingLeft;  // The setters left it pending (see editFrames)
+  byte latest; // The slot of the latest frame published (see editFrames)
+  byte scanLength[S7_FRAMES]; // Number of steps in the scan order of each frame
+  byte scanPos;       // Position of 'common' in the scan order
+  boolean skipEmpty;  // See setSkipEmptySteps()
+  boolean minTransitions; // See setMinimalTransitions()
+  byte numPorts;
   byte numDigits;
+  byte numSteps;
   byte common;
   int ledOnTime;
+  unsigned int duty; // Lit part of each step, out of 65535 (see SevSegTimer.h)
+  byte compensation; // See setCompensation()
+  unsigned long stepStart; // When the current step was lit (see pollDisplay)
   const static long powersOf10[10];
+  const static uint16_t gammaTable[256]; // Read with pgm_read_word()
+  const static byte digitCodeMap[12];
+
+  friend struct SevSegBenchmark; // See examples/SevSeg_Benchmark
+  friend class SevSegTimer;
+};
 
+
+// SevSeg is configured at run time, in begin(), and can drive displays of up
+// to S7_DIGITS digits.
+class SevSeg : public SevSegBase
+{
+public:
+  SevSeg();
+  void begin(const byte hardwareConfig, const byte numDigitsIn,
+             const byte digitPinsIn[],  const byte segmentPinsIn[],
+             const byte resistorsIn = S7_RESISTORS);
+
+private:
+  byte digitData[S7_DIGIT_DATA(S7_DIGITS)];
+  byte frameData[S7_FRAME_DATA(S7_STEPS)];
+};
+
+
+// SevSegT is configured at compile time, e.g.:
+//   SevSegT<4, S7_COMMON_ANODE, S7_R_ON_DIGITS> sevseg;
+// Its arrays are sized for exactly that display, and nothing else needs to be
+// given to begin() than the pins.
+template <byte DIGITS, byte CONFIG, byte RESISTORS = S7_RESISTORS>
+class SevSegT : public SevSegBase
+{
+public:
+  SevSegT() : SevSegBase(DIGITS, STEPS, digitData, frameData) {}
+  void begin(const byte digitPinsIn[], const byte segmentPinsIn[]) {
+    SevSegBase::begin(CONFIG, DIGITS, digitPinsIn, segmentPinsIn, RESISTORS);
+  }
+
+private:
+#ifdef S7_CHARLIEPLEX
+  // useCharlieplexing() scans one digit per step, whatever RESISTORS
+  static const byte STEPS = (DIGITS > S7_SEGMENTS) ? DIGITS : S7_SEGMENTS;
+#else
+  static const byte STEPS = (RESISTORS == S7_R_ON_SEGMENTS) ? DIGITS : S7_SEGMENTS;
+#endif
+  byte digitData[S7_DIGIT_DATA(DIGITS)];
+  byte frameData[S7_FRAME_DATA(STEPS)];
 };
 
 #endif //SevSeg_h
@@ -0,0 +1,224 @@
+/* SevSeg Library - Timer driver
+
+ Copyright 2014 Dean Reading
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+
+ Refreshes a SevSeg display from a hardware timer interrupt, so that the main
+ loop spends no time on it:
+
+   #include "SevSegTimer.h"
+   ...
+   sevseg.begin(...);
+   SevSegTimer::begin(sevseg, 1000); // 1000 steps per second
+
+ Each timer tick lights one refresh step (see SevSeg::updateDisplay()). The
+ brightness set with SevSeg::setBrightness() decides which part of the tick
+ the step stays lit, so the frame rate does not depend on it.
+
+ Alternatively, SevSegTimer::beginBCM() drives the display with binary code
+ modulation (see SevSeg::updateDisplayBCM()), which gives each digit its own
+ brightness, set with SevSeg::setDigitBrightness().
+
+ This file defines the timer interrupt handlers: include it in one source file
+ only. Timer2 is used by default, as Timer1 is often taken (e.g. by the Servo
+ library). Define S7_TIMER to 1 before including this file to use Timer1.
+ On a host build (see extras/host), the simulated HostHAL::timer is used.
+ */
+
+#ifndef SevSegTimer_h
+#define SevSegTimer_h
+
+#include "SevSeg.h"
+
+#ifndef S7_TIMER
+#define S7_TIMER 2
+#endif
+
+// Timer registers
+/******************************************************************************/
+// 'S7_TIMER_CS' are the clock select bits for each prescaler in 'S7_TIMER_DIV'
+
+#if defined(HOST_HAL)
+#define S7_OCRA        HostHAL::timer.top
+#define S7_OCRB        HostHAL::timer.compareB
+typedef unsigned long  S7TimerTicks;
+
+#elif S7_TIMER == 1
+#define S7_OCRA        OCR1A
+#define S7_OCRB        OCR1B
+#define S7_TIMER_MAX   65536UL
+typedef unsigned long  S7TimerTicks;
+static const unsigned int S7_TIMER_DIV[] = {1, 8, 64, 256, 1024};
+static const byte S7_TIMER_CS[] = {_BV(CS10), _BV(CS11), _BV(CS11) | _BV(CS10),
+                                   _BV(CS12), _BV(CS12) | _BV(CS10)};
+
+#elif S7_TIMER == 2
+#define S7_OCRA        OCR2A
+#define S7_OCRB        OCR2B
+#define S7_TIMER_MAX   256UL
+typedef unsigned int   S7TimerTicks;
+static const unsigned int S7_TIMER_DIV[] = {1, 8, 32, 64, 128, 256, 1024};
+static const byte S7_TIMER_CS[] = {1, 2, 3, 4, 5, 6, 7};
+
+#else
+#error "S7_TIMER must be 1 or 2"
+#endif
+
+
+class SevSegTimer
+{
+public:
+  static void begin(SevSegBase &displayIn, unsigned int stepFrequency);
+  static void beginBCM(SevSegBase &displayIn, unsigned long tickFrequency);
+  static void end();
+
+  static void compareA();
+  static void compareB();
+
+private:
+  static S7TimerTicks start(unsigned long frequency, byte shift, boolean bcm);
+
+  static SevSegBase *display;
+  static S7TimerTicks bcmTicks; // Length of the shortest plane, 0 without BCM
+};
+
+SevSegBase *SevSegTimer::display = 0;
+S7TimerTicks SevSegTimer::bcmTicks = 0;
+
+
+// begin, beginBCM & end
+/******************************************************************************/
+// begin() starts calling updateDisplay() 'stepFrequency' times per second.
+// A full frame takes one step per segment (or per digit, with resistors on the
+// segments): keep stepFrequency above 8 x 60Hz to avoid flickering.
+//
+// beginBCM() calls updateDisplayBCM() instead, with 'tickFrequency' being the
+// rate of the time unit of the shortest bit-plane. A step then takes
+// 2^S7_BCM_BITS - 1 units, e.g. a frame of 8 steps takes 2040 units with 8
+// bits. The shortest plane must leave time for the interrupt to run, so lower
+// S7_BCM_BITS rather than raising tickFrequency too much.
+
+void SevSegTimer::begin(SevSegBase &displayIn, unsigned int stepFrequency) {
+  end();
+  display = &displayIn;
+  bcmTicks = 0;
+  start(stepFrequency, 0, false);
+}
+
+void SevSegTimer::beginBCM(SevSegBase &displayIn, unsigned long tickFrequency) {
+  end();
+  display = &displayIn;
+  // The longest plane must fit in the timer
+  bcmTicks = start(tickFrequency, S7_BCM_BITS - 1, true);
+}
+
+// Sets the timer period to one tick at 'frequency', using the smallest
+// prescaler that fits (tick << shift) in the timer. Returns the tick length.
+S7TimerTicks SevSegTimer::start(unsigned long frequency, byte shift, boolean bcm) {
+#if defined(HOST_HAL)
+  (void)shift;
+  const S7TimerTicks ticks = 1000000UL / frequency;
+  HostHAL::timer.count = 0;
+  HostHAL::timer.top = ticks - 1;
+  HostHAL::timer.compareB = 0;
+  HostHAL::timer.onCompareA = compareA;
+  HostHAL::timer.onCompareB = bcm ? 0 : compareB;
+  HostHAL::timer.running = true;
+#else
+  const unsigned long cycles = F_CPU / frequency;
+  byte prescaler = 0;
+  while (prescaler < sizeof(S7_TIMER_CS) - 1 &&
+         (cycles / S7_TIMER_DIV[prescaler]) << shift > S7_TIMER_MAX) {
+    prescaler++;
+  }
+  S7TimerTicks ticks = constrain(cycles / S7_TIMER_DIV[prescaler],
+                                 2, S7_TIMER_MAX >> shift);
+
+#if S7_TIMER == 1
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12) | S7_TIMER_CS[prescaler]; // CTC mode
+  TCNT1 = 0;
+  OCR1A = ticks - 1;
+  OCR1B = 0;
+  TIFR1 = _BV(OCF1A) | _BV(OCF1B);
+  TIMSK1 |= bcm ? _BV(OCIE1A) : _BV(OCIE1A) | _BV(OCIE1B);
+#else
+  TCCR2A = _BV(WGM21); // CTC mode
+  TCCR2B = S7_TIMER_CS[prescaler];
+  TCNT2 = 0;
+  OCR2A = ticks - 1;
+  OCR2B = 0;
+  TIFR2 = _BV(OCF2A) | _BV(OCF2B);
+  TIMSK2 |= bcm ? _BV(OCIE2A) : _BV(OCIE2A) | _BV(OCIE2B);
+#endif
+#endif
+  return ticks;
+}
+
+// Stops the timer and switches the display off.
+void SevSegTimer::end() {
+#if defined(HOST_HAL)
+  HostHAL::timer.running = false;
+#elif S7_TIMER == 1
+  TIMSK1 &= ~(_BV(OCIE1A) | _BV(OCIE1B));
+  TCCR1B = 0;
+#else
+  TIMSK2 &= ~(_BV(OCIE2A) | _BV(OCIE2B));
+  TCCR2B = 0;
+#endif
+  if (display) {
+    display->clearDisplay();
+  }
+}
+
+
+// compareA & compareB
+/******************************************************************************/
+// Compare A marks the start of a tick: the next step (or bit-plane) is lit.
+// Compare B marks the end of the lit part of the tick. The next compare B is
+// then set from the brightness of the next step: it cannot be missed, as the
+// counter has just gone past it. A compare B on the last count of the tick
+// would run after compare A, so the lit part is kept below 'top'. At full duty
+// cycle, the step simply stays lit.
+
+void SevSegTimer::compareA() {
+  if (bcmTicks) {
+    // The plane just lit lasts 2^plane ticks
+    S7_OCRA = (bcmTicks << display->updateDisplayBCM()) - 1;
+  }
+  else {
+    display->updateDisplay();
+  }
+}
+
+void SevSegTimer::compareB() {
+  if (display->stepDuty(display->common) != 0xFFFF) {
+    display->lightsOff(display->common);
+  }
+  const unsigned int nextDuty = display->stepDuty(display->nextStep());
+  S7_OCRB = ((unsigned long)S7_OCRA * nextDuty) >> 16;
+}
+
+#ifndef HOST_HAL
+#if S7_TIMER == 1
+ISR(TIMER1_COMPA_vect) { SevSegTimer::compareA(); }
+ISR(TIMER1_COMPB_vect) { SevSegTimer::compareB(); }
+#else
+ISR(TIMER2_COMPA_vect) { SevSegTimer::compareA(); }
+ISR(TIMER2_COMPB_vect) { SevSegTimer::compareB(); }
+#endif
+#endif
+
+#endif //SevSegTimer_h
+/// END ///
@@ -0,0 +1,189 @@
+/* SevSeg Benchmark Example
+ 
+ Copyright 2014 Dean Reading
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ 
+ 
+ This example measures how many CPU cycles each SevSeg function takes, for
+ every display size from 1 to S7_DIGITS digits, and both locations of the
+ current-limiting resistors. It is written for the ATmega328P (Uno, Nano,
+ Pro Mini), and uses Timer1 as a cycle counter.
+
+ The results are printed on the serial port (115200 baud) as a CSV table:
+   function,digits,resistors,cycles
+
+ Every number measured fits on the display, so that the cost of converting it
+ is measured rather than the shortcut taken for out-of-range numbers.
+
+ No display needs to be connected. The sketch also runs unmodified under the
+ simavr simulator, which prints the serial output to the console, and quits
+ once the table is complete. extras/benchmark/run_simavr.sh builds and runs
+ it in one go:
+   extras/benchmark/run_simavr.sh > cycles.csv
+ */
+
+#include <avr/sleep.h>
+#include "SevSeg.h"
+
+SevSeg sevseg; //Instantiate a seven segment controller object
+
+byte digitPins[] = {2, 3, 4, 5, A0, A1, A2, A3, A4};
+byte segmentPins[] = {6, 7, 8, 9, 10, 11, 12, 13};
+
+volatile unsigned int overflows;
+unsigned long overhead = 0;
+
+ISR(TIMER1_OVF_vect) {
+  overflows++;
+}
+
+void startCount() {
+  overflows = 0;
+  TCNT1 = 0;
+  TCCR1B = _BV(CS10); // Count every CPU cycle
+}
+
+unsigned long stopCount() {
+  TCCR1B = 0;
+  unsigned long cycles = ((unsigned long)overflows << 16) | TCNT1;
+  if (TIFR1 & _BV(TOV1)) { // Overflow not serviced yet
+    cycles += 0x10000UL;
+    TIFR1 = _BV(TOV1);
+  }
+  return cycles - overhead;
+}
+
+// Cycles taken by one evaluation of 'statement'
+#define CYCLES(statement) (startCount(), (statement), stopCount())
+
+// Has access to the private functions of SevSeg
+struct SevSegBenchmark {
+  static byte resistors;
+  static long fit(long widest, byte numDigits);
+  static long fitSigned(long widest, byte numDigits);
+  static void run(byte numDigits);
+  static void print(const char *function, byte numDigits, unsigned long cycles);
+};
+
+byte SevSegBenchmark::resistors;
+
+void SevSegBenchmark::print(const char *function, byte numDigits,
+                            unsigned long cycles) {
+  Serial.print(function);
+  Serial.print(',');
+  Serial.print(numDigits);
+  Serial.print(',');
+  Serial.print(resistors == S7_R_ON_SEGMENTS ? "segments" : "digits");
+  Serial.print(',');
+  Serial.println(cycles);
+  Serial.flush(); // Don't let serial interrupts disturb the next measurement
+}
+
+// The widest number up to 'widest' that fits on numDigits digits: all nines
+long SevSegBenchmark::fit(long widest, byte numDigits) {
+  const long nines = SevSegBase::powersOf10[numDigits] - 1;
+  return (widest < nines) ? widest : nines;
+}
+
+// Same, but negative when there is room for the minus sign
+long SevSegBenchmark::fitSigned(long widest, byte numDigits) {
+  if (numDigits == 1) return fit(widest, 1);
+  return -fit(widest, numDigits - 1);
+}
+
+void SevSegBenchmark::run(byte numDigits) {
+  byte digits[S7_DIGITS];
+  byte allLit[S7_DIGITS];
+  memset(allLit, 0xFF, sizeof(allLit));
+
+  // The numbers are worked out before timing anything: the widest of each type
+  // that fits. They are volatile so that the compiler cannot move their
+  // conversions (e.g. the float ones) into the timed calls; only reading them
+  // back is timed.
+  volatile long wideLong = fitSigned(999999999L, numDigits);
+  volatile unsigned long wideUnsignedLong = fit(999999999L, numDigits);
+  volatile int wideInt = fitSigned(32767, numDigits);
+  volatile unsigned int wideUnsignedInt = fit(65535U, numDigits);
+  volatile char wideChar = fitSigned(127, numDigits);
+  volatile byte wideByte = fit(255, numDigits);
+#ifndef S7_NO_FLOAT
+  volatile float wideFloat = fitSigned(999999L, numDigits) / 10.0f; // 6 digits
+#endif
+  // The same number, in 16.16 fixed point: at most 5 integer digits
+  volatile long wideFixed = fitSigned(327679L, numDigits) * 6553.6f;
+
+  sevseg.begin(S7_COMMON_ANODE, numDigits, digitPins, segmentPins, resistors);
+  sevseg.setBrightness(0);
+  sevseg.setSegments(allLit); // Worst case: all segments lit
+
+  print("lightsOn", numDigits, CYCLES(sevseg.lightsOn(0)));
+  print("lightsOff", numDigits, CYCLES(sevseg.lightsOff(0)));
+  print("updateDisplay", numDigits, CYCLES(sevseg.updateDisplay()));
+  print("refreshDisplay", numDigits, CYCLES(sevseg.refreshDisplay()));
+  print("clearDisplay", numDigits, CYCLES(sevseg.clearDisplay()));
+  print("findDigits", numDigits, CYCLES(sevseg.findDigits(wideLong, 1, digits)));
+  print("setDigitCodes", numDigits, CYCLES(sevseg.setDigitCodes(digits, 1)));
+  print("compileFrames", numDigits, CYCLES(sevseg.compileFrames()));
+
+  // setNumber() skips a number that is already shown: put the segments back
+  // before each one, so that they all convert their number
+  sevseg.setSegments(allLit);
+  print("setNumber(long)", numDigits, CYCLES(sevseg.setNumber(wideLong, 1)));
+  sevseg.setSegments(allLit);
+  print("setNumber(unsigned long)", numDigits, CYCLES(sevseg.setNumber(wideUnsignedLong, 1)));
+  sevseg.setSegments(allLit);
+  print("setNumber(int)", numDigits, CYCLES(sevseg.setNumber(wideInt, 1)));
+  sevseg.setSegments(allLit);
+  print("setNumber(unsigned int)", numDigits, CYCLES(sevseg.setNumber(wideUnsignedInt, 1)));
+  sevseg.setSegments(allLit);
+  print("setNumber(char)", numDigits, CYCLES(sevseg.setNumber(wideChar, 1)));
+  sevseg.setSegments(allLit);
+  print("setNumber(byte)", numDigits, CYCLES(sevseg.setNumber(wideByte, 1)));
+#ifndef S7_NO_FLOAT
+  sevseg.setSegments(allLit);
+  print("setNumber(float)", numDigits, CYCLES(sevseg.setNumber(wideFloat, 1)));
+#endif
+  sevseg.setSegments(allLit);
+  print("setNumberFixed", numDigits, CYCLES(sevseg.setNumberFixed(wideFixed, 16, 1)));
+  sevseg.setNumber(0, 1);
+  print("increment", numDigits, CYCLES(sevseg.increment()));
+}
+
+void setup() {
+  Serial.begin(115200);
+
+  TIMSK0 = 0; // Stop the millis() interrupt from adding noise
+  TCCR1A = 0;
+  TCCR1B = 0;
+  TIMSK1 = _BV(TOIE1);
+  overhead = CYCLES(0);
+
+  Serial.println(F("function,digits,resistors,cycles"));
+  for (byte resistors = S7_R_ON_DIGITS ; resistors <= S7_R_ON_SEGMENTS ; resistors++) {
+    SevSegBenchmark::resistors = resistors;
+    for (byte numDigits = 1 ; numDigits <= S7_DIGITS ; numDigits++) {
+      SevSegBenchmark::run(numDigits);
+    }
+  }
+
+  // Halt. Under simavr, sleeping with interrupts off ends the simulation.
+  cli();
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  sleep_enable();
+  sleep_cpu();
+}
+
+void loop() {
+}
+
+/// END ///
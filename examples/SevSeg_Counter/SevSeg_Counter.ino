@@ -29,6 +29,7 @@ void setup() {
 
   sevseg.begin(COMMON_ANODE, numDigits, digitPins, segmentPins);
   sevseg.setBrightness(90);
+  sevseg.setNumber(0, 1);
 }
 
 void loop() {
@@ -40,8 +41,11 @@ void loop() {
     timer += 100; 
     if (deciSeconds == 10000) { // Reset to 0 after counting for 1000 seconds.
       deciSeconds=0;
+      sevseg.setNumber(0, 1);
+    }
+    else {
+      sevseg.increment(); // Only updates the digits that change
     }
-    sevseg.setNumber(deciSeconds, 1);
   }
 
   sevseg.refreshDisplay(); // Must run repeatedly
@@ -42,10 +42,10 @@ void setup()
   byte segmentPins[] = {6, 7, 8, 9, 10, 11, 12, 13}; //Segments: A,B,C,D,E,F,G,Period
 
   sevseg.begin(COMMON_ANODE, numDigits, digitPins, segmentPins);
-  sevseg.setBrightness(10); //Note: 100 brightness simply corresponds to a delay of 2000us after lighting each segment. A brightness of 0 
+  sevseg.setBrightness(38); //Note: 100 brightness simply corresponds to a delay of 2000us after lighting each segment. A brightness of 0 
                             //is a delay of 1us; it doesn't really affect brightness as much as it affects update rate (frequency).
                             //Therefore, for a 4-digit 7-segment + pd, COMMON_ANODE display, the max update rate for a "brightness" of 100 is 1/(2000us*8) = 62.5Hz.
-                            //I am choosing a "brightness" of 10 because it increases the max update rate to approx. 1/(200us*8) = 625Hz.
+                            //Brightness follows a gamma curve: a "brightness" of 38 gives a delay of approx. 200us, which increases the max update rate to approx. 1/(200us*8) = 625Hz.
                             //This is preferable, as it decreases aliasing when recording the display with a video camera....I think.
 }
 
@@ -0,0 +1,36 @@
+#!/bin/sh
+# SevSeg Library - Benchmark runner
+#
+# Copyright 2014 Dean Reading
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+#
+# Builds examples/SevSeg_Benchmark for an ATmega328P and runs it under simavr,
+# printing its CSV table (function,digits,resistors,cycles) on stdout.
+# Needs arduino-cli, with the arduino:avr core installed, and simavr.
+#
+# Usage: extras/benchmark/run_simavr.sh [S7_DIGITS]
+
+set -e
+
+library=$(cd "$(dirname "$0")/../.." && pwd)
+build=$(mktemp -d)
+trap 'rm -rf "$build"' EXIT
+
+arduino-cli compile --fqbn arduino:avr:uno --library "$library" \
+  --build-property "compiler.cpp.extra_flags=-DS7_DIGITS=${1:-4}" \
+  --output-dir "$build" "$library/examples/SevSeg_Benchmark" >&2
+
+# simavr colours the serial output and adds its own messages: keep the table
+simavr -m atmega328p -f 16000000 "$build/SevSeg_Benchmark.ino.elf" 2>&1 |
+  sed 's/\x1b\[[0-9;]*m//g' | grep ','
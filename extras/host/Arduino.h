@@ -0,0 +1,208 @@
+/* SevSeg Library - Host HAL
+
+ Copyright 2014 Dean Reading
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+
+ A stand-in for the Arduino core, so that SevSeg.cpp can be built and run on a
+ desktop machine. Put this directory first on the include path, e.g.:
+
+   g++ -I extras/host -I . SevSeg.cpp extras/host/HostHAL.cpp main.cpp
+
+ Pins are simulated AVR-style: digital pin P belongs to port (P / 8), bit
+ (P % 8). Every register write is counted and time-stamped against a virtual
+ microsecond clock, which only moves when delay(), delayMicroseconds() or
+ HostHAL::advance() are called.
+ */
+
+#ifndef HostHAL_Arduino_h
+#define HostHAL_Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "binary.h"
+
+#define HOST_HAL 1
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+typedef bool    boolean;
+typedef uint8_t byte;
+
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int  digitalRead(uint8_t pin);
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+
+// Simulated I/O space
+/******************************************************************************/
+
+#define HOST_PORTS  4 // 32 digital pins
+#define HOST_PINS   (HOST_PORTS * 8)
+
+namespace HostHAL {
+
+// An 8-bit I/O register. Behaves like a 'volatile uint8_t', but remembers how
+// many times it was written and when each of its bits last changed.
+struct Register {
+  uint8_t value;
+  unsigned long writes;
+  unsigned long changedAt[8];
+
+  operator uint8_t() const volatile { return value; }
+  void operator=(uint8_t newValue) volatile;
+  void operator|=(uint8_t bits) volatile { *this = value | bits; }
+  void operator&=(uint8_t bits) volatile { *this = value & bits; }
+  void operator^=(uint8_t bits) volatile { *this = value ^ bits; }
+};
+
+struct Port {
+  Register out;  // PORTx: output level (or pull-up when an input)
+  Register mode; // DDRx:  1 = output, 0 = input (Hi-Z)
+};
+
+extern volatile Port ports[HOST_PORTS];
+
+// A 16-bit timer in CTC mode, ticking once per microsecond. Like an AVR timer,
+// it counts from 0 to 'top', raising compare A when it reaches 'top' and
+// compare B when it reaches 'compareB'. Handlers are called with interrupts
+// disabled, and deferred while they are disabled.
+struct Timer {
+  boolean running;
+  unsigned long count;
+  unsigned long top;
+  unsigned long compareB;
+  void (*onCompareA)();
+  void (*onCompareB)();
+  boolean pendingA, pendingB;
+};
+
+extern Timer timer;
+
+// A chain of 74HC595 shift registers, wired to simulated pins. Like the real
+// ones, they shift in 'dataPin' on the rising edges of 'clockPin', chip 0
+// first, and copy what was shifted in to their outputs on the rising edges of
+// 'latchPin'.
+#define HOST_CHIPS  8
+
+struct ShiftChain {
+  uint8_t dataPin, clockPin, latchPin;
+  uint8_t chips; // 0 when there is no chain
+  uint8_t shifted[HOST_CHIPS], outputs[HOST_CHIPS];
+  boolean clockLevel, latchLevel;
+  unsigned long latches;
+};
+
+extern ShiftChain chain;
+
+// A MAX7219 display controller. It shifts in 'dataPin' on the rising edges of
+// 'clockPin', MSB first, and on the rising edges of 'loadPin' writes the last
+// 16 bits shifted in: a register address, then its value.
+struct Max7219 {
+  uint8_t dataPin, clockPin, loadPin;
+  boolean attached;
+  uint16_t shifted;
+  uint8_t regs[16]; // 1..8 are the digits
+  boolean clockLevel, loadLevel;
+  unsigned long loads; // Register writes
+};
+
+extern Max7219 max7219;
+
+// A TM1637 display controller, on a 2-wire bus pulled up by resistors: a line
+// is low only while a pin drives it low (output, level LOW). Frames start with
+// data falling while the clock is high, and stop with data rising while the
+// clock is high. Bytes are sent LSB first, each followed by an acknowledge
+// clock. The first byte of a frame is a command; the next ones are written
+// to the digit registers.
+struct Tm1637 {
+  uint8_t dataPin, clockPin;
+  boolean attached;
+  boolean clockLevel, dataLevel;
+  boolean inFrame, fixedAddress;
+  uint8_t bits, value, bytes; // Progress through the frame
+  uint8_t address;
+  uint8_t digits[6];
+  uint8_t control; // Last display control command
+  unsigned long digitWrites;
+};
+
+extern Tm1637 tm1637;
+
+void reset();                         // All pins Hi-Z, clock and counters at 0
+void advance(unsigned long us);       // Move the virtual clock forward,
+                                      // running the timer handlers on the way
+
+unsigned long now();                  // Same as micros()
+unsigned long writes();               // Total register writes since reset()
+unsigned long frameWrites();          // Register writes during the last
+                                      // full display frame
+void frameStart();                    // Called by SevSeg as a frame starts
+uint8_t level(uint8_t pin);           // Last level written to PORTx
+boolean isOutput(uint8_t pin);
+unsigned long lastChange(uint8_t pin); // Time the pin last changed level
+
+void attachShiftChain(uint8_t dataPin, uint8_t clockPin, uint8_t latchPin,
+                      uint8_t chips);
+uint8_t chainLevel(uint8_t output);   // Latched level of an output of the
+                                      // chain: Q0..Q7 of chip 0, then chip 1...
+void attachMax7219(uint8_t dataPin, uint8_t clockPin, uint8_t loadPin);
+void attachTm1637(uint8_t dataPin, uint8_t clockPin);
+boolean busLevel(uint8_t pin);        // Level of a pulled-up, open-drain line
+
+// Tri-state pins: a pin is an output driving its level, or an input, which
+// only weakly pulls the line up when its pull-up is enabled. An LED between
+// two pins is lit when they drive it forward; a pull-up is too weak for that.
+enum Drive { HIGH_Z, PULLED_UP, DRIVEN_LOW, DRIVEN_HIGH };
+Drive drive(uint8_t pin);
+boolean ledLit(uint8_t anodePin, uint8_t cathodePin);
+
+} // namespace HostHAL
+
+
+// AVR core compatibility
+/******************************************************************************/
+
+#define NOT_A_PIN  0
+#define NOT_A_PORT 0
+
+#define digitalPinToPort(P)    ((P) < HOST_PINS ? ((P) >> 3) + 1 : NOT_A_PORT)
+#define digitalPinToBitMask(P) ((uint8_t)(1 << ((P) & 7)))
+#define portOutputRegister(P)  (&HostHAL::ports[(P) - 1].out)
+#define portModeRegister(P)    (&HostHAL::ports[(P) - 1].mode)
+
+extern volatile uint8_t SREG;
+void cli();
+void sei();
+
+#endif //HostHAL_Arduino_h
+/// END ///
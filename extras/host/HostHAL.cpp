@@ -0,0 +1,340 @@
+/* SevSeg Library - Host HAL
+
+ Copyright 2014 Dean Reading
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+
+ Simulated pin bank and virtual clock. See Arduino.h in this directory.
+ */
+
+#include "Arduino.h"
+
+volatile uint8_t SREG = 0x80; // Interrupts enabled, as after init()
+
+namespace HostHAL {
+
+volatile Port ports[HOST_PORTS];
+Timer timer;
+ShiftChain chain;
+Max7219 max7219;
+Tm1637 tm1637;
+
+static unsigned long clock = 0;
+static unsigned long totalWrites = 0;
+static unsigned long frameStartWrites = 0; // 'totalWrites' at frameStart()
+static unsigned long lastFrameWrites = 0;
+
+
+// Register
+/******************************************************************************/
+
+static void updateChain();
+static void updateMax7219();
+static void updateTm1637();
+
+void Register::operator=(uint8_t newValue) volatile {
+  const uint8_t changed = value ^ newValue;
+  for (byte bit = 0 ; bit < 8 ; bit++) {
+    if (changed & (1 << bit)) {
+      changedAt[bit] = clock;
+    }
+  }
+  value = newValue;
+  writes++;
+  totalWrites++;
+  if (chain.chips) updateChain();
+  if (max7219.attached) updateMax7219();
+  if (tm1637.attached) updateTm1637();
+}
+
+
+// ShiftChain
+/******************************************************************************/
+
+void attachShiftChain(uint8_t dataPin, uint8_t clockPin, uint8_t latchPin,
+                      uint8_t chips) {
+  memset(&chain, 0, sizeof(chain));
+  chain.dataPin = dataPin;
+  chain.clockPin = clockPin;
+  chain.latchPin = latchPin;
+  chain.clockLevel = level(clockPin);
+  chain.latchLevel = level(latchPin);
+  chain.chips = (chips < HOST_CHIPS) ? chips : HOST_CHIPS;
+}
+
+uint8_t chainLevel(uint8_t output) {
+  return (chain.outputs[output >> 3] >> (output & 7)) & 1;
+}
+
+// Called after each register write: looks for rising edges on the clock and
+// latch pins.
+static void updateChain() {
+  const boolean clock = level(chain.clockPin);
+  const boolean latch = level(chain.latchPin);
+  if (clock && !chain.clockLevel) {
+    // Each chip passes its Q7 on to the next one
+    for (byte chip = chain.chips - 1 ; chip > 0 ; chip--) {
+      chain.shifted[chip] = (chain.shifted[chip] << 1) |
+                            (chain.shifted[chip - 1] >> 7);
+    }
+    chain.shifted[0] = (chain.shifted[0] << 1) | level(chain.dataPin);
+  }
+  if (latch && !chain.latchLevel) {
+    memcpy(chain.outputs, chain.shifted, chain.chips);
+    chain.latches++;
+  }
+  chain.clockLevel = clock;
+  chain.latchLevel = latch;
+}
+
+
+// Max7219 & Tm1637
+/******************************************************************************/
+
+void attachMax7219(uint8_t dataPin, uint8_t clockPin, uint8_t loadPin) {
+  memset(&max7219, 0, sizeof(max7219));
+  max7219.dataPin = dataPin;
+  max7219.clockPin = clockPin;
+  max7219.loadPin = loadPin;
+  max7219.clockLevel = level(clockPin);
+  max7219.loadLevel = level(loadPin);
+  max7219.attached = true;
+}
+
+void attachTm1637(uint8_t dataPin, uint8_t clockPin) {
+  memset(&tm1637, 0, sizeof(tm1637));
+  tm1637.dataPin = dataPin;
+  tm1637.clockPin = clockPin;
+  tm1637.clockLevel = busLevel(clockPin);
+  tm1637.dataLevel = busLevel(dataPin);
+  tm1637.attached = true;
+}
+
+boolean busLevel(uint8_t pin) {
+  return !(isOutput(pin) && level(pin) == LOW);
+}
+
+static void updateMax7219() {
+  const boolean clock = level(max7219.clockPin);
+  const boolean load = level(max7219.loadPin);
+  if (clock && !max7219.clockLevel) {
+    max7219.shifted = (max7219.shifted << 1) | level(max7219.dataPin);
+  }
+  if (load && !max7219.loadLevel) {
+    max7219.regs[(max7219.shifted >> 8) & 0x0F] = max7219.shifted & 0xFF;
+    max7219.loads++;
+  }
+  max7219.clockLevel = clock;
+  max7219.loadLevel = load;
+}
+
+static void updateTm1637() {
+  const boolean clock = busLevel(tm1637.clockPin);
+  const boolean data = busLevel(tm1637.dataPin);
+  if (clock && tm1637.clockLevel && data != tm1637.dataLevel) {
+    // Start or stop condition
+    tm1637.inFrame = !data;
+    tm1637.bits = tm1637.value = tm1637.bytes = 0;
+  }
+  else if (clock && !tm1637.clockLevel && tm1637.inFrame) {
+    if (tm1637.bits < 8) {
+      tm1637.value |= data << tm1637.bits++;
+    }
+    else {
+      // Acknowledge clock: the byte is complete
+      const uint8_t value = tm1637.value;
+      if (tm1637.bytes++) {
+        tm1637.digits[tm1637.address % 6] = value;
+        tm1637.digitWrites++;
+        if (!tm1637.fixedAddress) tm1637.address++;
+      }
+      else if ((value & 0xC0) == 0x40) {
+        tm1637.fixedAddress = value & 0x04;
+      }
+      else if ((value & 0xC0) == 0xC0) {
+        tm1637.address = value & 0x0F;
+      }
+      else if ((value & 0xC0) == 0x80) {
+        tm1637.control = value;
+      }
+      tm1637.bits = tm1637.value = 0;
+    }
+  }
+  tm1637.clockLevel = clock;
+  tm1637.dataLevel = data;
+}
+
+
+// reset & advance
+/******************************************************************************/
+
+void reset() {
+  for (byte port = 0 ; port < HOST_PORTS ; port++) {
+    memset((void *)&ports[port], 0, sizeof(Port));
+  }
+  memset(&timer, 0, sizeof(timer));
+  memset(&chain, 0, sizeof(chain));
+  memset(&max7219, 0, sizeof(max7219));
+  memset(&tm1637, 0, sizeof(tm1637));
+  clock = 0;
+  totalWrites = 0;
+  frameStartWrites = 0;
+  lastFrameWrites = 0;
+  SREG = 0x80;
+}
+
+static void interrupt(void (*handler)(), boolean &pending) {
+  if (!(SREG & 0x80)) {
+    pending = true;
+    return;
+  }
+  pending = false;
+  SREG &= ~0x80;
+  if (handler) handler();
+  SREG |= 0x80;
+}
+
+void advance(unsigned long us) {
+  if (!timer.running) {
+    clock += us;
+    return;
+  }
+  while (us--) {
+    clock++;
+    if (timer.count >= timer.top) timer.count = 0;
+    else                          timer.count++;
+    if (timer.count == timer.top)      timer.pendingA = true;
+    if (timer.count == timer.compareB) timer.pendingB = true;
+    // Compare A has the higher priority, as on an AVR
+    if (timer.pendingA) interrupt(timer.onCompareA, timer.pendingA);
+    if (timer.pendingB) interrupt(timer.onCompareB, timer.pendingB);
+  }
+}
+
+
+// Inspection
+/******************************************************************************/
+
+unsigned long now() {
+  return clock;
+}
+
+unsigned long writes() {
+  return totalWrites;
+}
+
+unsigned long frameWrites() {
+  return lastFrameWrites;
+}
+
+void frameStart() {
+  lastFrameWrites = totalWrites - frameStartWrites;
+  frameStartWrites = totalWrites;
+}
+
+uint8_t level(uint8_t pin) {
+  return (ports[pin >> 3].out & digitalPinToBitMask(pin)) ? HIGH : LOW;
+}
+
+boolean isOutput(uint8_t pin) {
+  return ports[pin >> 3].mode & digitalPinToBitMask(pin);
+}
+
+unsigned long lastChange(uint8_t pin) {
+  return ports[pin >> 3].out.changedAt[pin & 7];
+}
+
+Drive drive(uint8_t pin) {
+  if (isOutput(pin)) return level(pin) ? DRIVEN_HIGH : DRIVEN_LOW;
+  return level(pin) ? PULLED_UP : HIGH_Z;
+}
+
+boolean ledLit(uint8_t anodePin, uint8_t cathodePin) {
+  return drive(anodePin) == DRIVEN_HIGH && drive(cathodePin) == DRIVEN_LOW;
+}
+
+} // namespace HostHAL
+
+
+// Arduino core
+/******************************************************************************/
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  const uint8_t port = digitalPinToPort(pin);
+  if (port == NOT_A_PORT) return;
+  const uint8_t bit = digitalPinToBitMask(pin);
+  volatile HostHAL::Register *ddr = portModeRegister(port);
+  volatile HostHAL::Register *out = portOutputRegister(port);
+
+  if (mode == OUTPUT) {
+    *ddr |= bit;
+  }
+  else {
+    *ddr &= ~bit;
+    if (mode == INPUT_PULLUP) *out |= bit;
+    else                      *out &= ~bit;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  const uint8_t port = digitalPinToPort(pin);
+  if (port == NOT_A_PORT) return;
+  const uint8_t bit = digitalPinToBitMask(pin);
+  volatile HostHAL::Register *out = portOutputRegister(port);
+
+  if (val == LOW) *out &= ~bit;
+  else            *out |= bit;
+}
+
+int digitalRead(uint8_t pin) {
+  return HostHAL::level(pin);
+}
+
+void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val) {
+  for (byte bit = 0 ; bit < 8 ; bit++) {
+    if (bitOrder == LSBFIRST) digitalWrite(dataPin, (val >> bit) & 1);
+    else                      digitalWrite(dataPin, (val >> (7 - bit)) & 1);
+    digitalWrite(clockPin, HIGH);
+    digitalWrite(clockPin, LOW);
+  }
+}
+
+unsigned long millis() {
+  return HostHAL::now() / 1000;
+}
+
+unsigned long micros() {
+  return HostHAL::now();
+}
+
+void delay(unsigned long ms) {
+  HostHAL::advance(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  HostHAL::advance(us);
+}
+
+void cli() {
+  SREG &= ~0x80;
+}
+
+void sei() {
+  SREG |= 0x80;
+}
+
+/// END ///
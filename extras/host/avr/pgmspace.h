@@ -0,0 +1,20 @@
+/* SevSeg Library - Host HAL
+
+ PROGMEM shim: on a host there is a single address space, so program memory
+ is read like any other memory.
+ */
+
+#ifndef HostHAL_pgmspace_h
+#define HostHAL_pgmspace_h
+
+#include <stdint.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+#define pgm_read_byte(addr)  (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)  (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+
+#endif //HostHAL_pgmspace_h
+/// END ///
@@ -0,0 +1,137 @@
+/* SevSeg Library - Charlieplexing test
+
+ Copyright 2014 Dean Reading
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+
+ Drives charlieplexed displays of 1 to 9 digits, common cathode and common
+ anode, through SevSeg and SevSegT. After each refresh step, the LEDs lit
+ between every pair of pins must belong to a single digit, and be segments
+ of its code. Over a frame, every segment of every digit must have been lit.
+
+   g++ -DS7_CHARLIEPLEX -DS7_DIGITS=9 -I extras/host -I . SevSeg.cpp \
+       extras/host/HostHAL.cpp extras/host/tests/charlieplex.cpp
+ */
+
+#include "SevSeg.h"
+#include <stdio.h>
+
+#define LINES (S7_SEGMENTS + 1)
+
+// Digit d has its common pin on line d, and segment s on line s (s < d) or
+// s + 1 (s >= d)
+static const byte linePins[LINES] = {2, 3, 4, 5, 6, 7, 8, 9, 10};
+static byte digitPins[LINES], segmentPins[S7_SEGMENTS];
+
+static unsigned long failures = 0, checks = 0;
+
+static void fail(const char *what, byte config, byte numDigits, long number) {
+  if (failures++ < 10) {
+    printf("FAIL %s: config %d, %d digits, number %ld\n",
+           what, config, numDigits, number);
+  }
+}
+
+// Adds the LEDs lit now to 'seen', one code per digit. Returns false if LEDs
+// of several digits, or of no digit, are lit at once.
+static boolean readLit(byte config, byte numDigits, byte seen[]) {
+  byte litDigits = 0;
+  for (byte common=0 ; common < LINES ; common++) {
+    byte code = 0;
+    for (byte line=0 ; line < LINES ; line++) {
+      if (line == common) continue;
+      const boolean lit = (config == S7_COMMON_CATHODE) ?
+        HostHAL::ledLit(linePins[line], linePins[common]) :
+        HostHAL::ledLit(linePins[common], linePins[line]);
+      if (lit) code |= 1 << (line < common ? line : line - 1);
+    }
+    if (!code) continue;
+    if (common >= numDigits) return false;
+    seen[common] |= code;
+    litDigits++;
+  }
+  return litDigits <= 1;
+}
+
+static void checkFrame(SevSegBase &sevseg, byte config, byte numDigits,
+                       long number) {
+  byte seen[LINES] = {0};
+  // The new frame starts once the current one is over. Then scan enough steps
+  // for a whole frame (fewer, as empty steps are skipped).
+  for (byte step=0 ; step < numDigits ; step++) {
+    sevseg.updateDisplay();
+  }
+  for (byte step=0 ; step < 2 * numDigits ; step++) {
+    sevseg.updateDisplay();
+    if (!readLit(config, numDigits, seen)) fail("ghost LEDs", config, numDigits, number);
+  }
+  for (byte digit=0 ; digit < numDigits ; digit++) {
+    checks++;
+    if (seen[digit] != sevseg.digitCodes[digit]) {
+      fail("lit segments", config, numDigits, number);
+    }
+  }
+  sevseg.clearDisplay();
+  for (byte line=0 ; line < LINES ; line++) {
+    if (HostHAL::drive(linePins[line]) != HostHAL::HIGH_Z) {
+      fail("not off", config, numDigits, number);
+    }
+  }
+}
+
+static void run(SevSegBase &sevseg, byte config, byte numDigits,
+                void (*begin)(SevSegBase &, byte, byte)) {
+  HostHAL::reset();
+  sevseg.useCharlieplexing();
+  begin(sevseg, config, numDigits);
+  for (long number = -99999 ; number < 1000000 ; number += 7919) {
+    sevseg.setNumber(number, (byte)(number & 3));
+    checkFrame(sevseg, config, numDigits, number);
+  }
+  byte all[LINES];
+  memset(all, 0xFF, sizeof(all));
+  sevseg.setSegments(all);
+  checkFrame(sevseg, config, numDigits, -1);
+}
+
+static void beginSevSeg(SevSegBase &sevseg, byte config, byte numDigits) {
+  ((SevSeg &)sevseg).begin(config, numDigits, digitPins, segmentPins);
+}
+
+template <byte CONFIG>
+static void beginSevSegT(SevSegBase &sevseg, byte, byte) {
+  ((SevSegT<LINES, CONFIG, S7_R_ON_DIGITS> &)sevseg).begin(digitPins, segmentPins);
+}
+
+int main() {
+  for (byte line=0 ; line < LINES ; line++) {
+    digitPins[line] = linePins[line];
+    if (line) segmentPins[line - 1] = linePins[line];
+  }
+
+  for (byte config = S7_COMMON_CATHODE ; config <= S7_COMMON_ANODE ; config++) {
+    for (byte numDigits = 1 ; numDigits <= S7_DIGITS ; numDigits++) {
+      SevSeg sevseg;
+      run(sevseg, config, numDigits, beginSevSeg);
+    }
+  }
+  // Sized at compile time, for one step per segment
+  SevSegT<LINES, S7_COMMON_CATHODE, S7_R_ON_DIGITS> cathode;
+  run(cathode, S7_COMMON_CATHODE, LINES, beginSevSegT<S7_COMMON_CATHODE>);
+  SevSegT<LINES, S7_COMMON_ANODE, S7_R_ON_DIGITS> anode;
+  run(anode, S7_COMMON_ANODE, LINES, beginSevSegT<S7_COMMON_ANODE>);
+
+  printf("%s: %lu digit checks, %lu failures\n",
+         failures ? "FAIL" : "PASS", checks, failures);
+  return failures ? 1 : 0;
+}
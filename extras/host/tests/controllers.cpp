@@ -0,0 +1,154 @@
+/* SevSeg Library - Display controller test
+
+ Copyright 2014 Dean Reading
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+
+ Drives the simulated MAX7219 and TM1637 (see HostHAL::attachMax7219() and
+ HostHAL::attachTm1637()), with 1 to 9 digits, beyond what either controller
+ has. The digit registers they decode from the bus must always match
+ 'digitCodes', a change of one digit must cost one digit write, and the
+ brightness, clearDisplay() and the refresh functions must reach the
+ controller.
+
+   g++ -DS7_DIGITS=9 -I extras/host -I . SevSeg.cpp \
+       extras/host/HostHAL.cpp extras/host/tests/controllers.cpp
+ */
+
+#include "SevSeg.h"
+#include <stdio.h>
+
+#define MAX7219_LOAD   10
+#define MAX7219_DATA   11
+#define MAX7219_CLOCK  13
+#define TM1637_DATA    4
+#define TM1637_CLOCK   5
+
+static unsigned long failures = 0, checks = 0;
+
+static void check(boolean ok, const char *what, boolean max7219, byte numDigits) {
+  checks++;
+  if (!ok && failures++ < 10) {
+    printf("FAIL %s: %s, %d digits\n", what, max7219 ? "MAX7219" : "TM1637", numDigits);
+  }
+}
+
+// The MAX7219 has DP,A..G in bits 7..0, and the leftmost digit last
+static byte decodedCode(boolean max7219, byte numDigits, byte digit) {
+  if (!max7219) return HostHAL::tm1637.digits[digit];
+  const byte segments = HostHAL::max7219.regs[numDigits - digit];
+  byte code = segments & B10000000;
+  for (byte segment=0 ; segment < 7 ; segment++) {
+    if (segments & (B01000000 >> segment)) code |= 1 << segment;
+  }
+  return code;
+}
+
+static unsigned long digitWrites(boolean max7219) {
+  return max7219 ? HostHAL::max7219.loads : HostHAL::tm1637.digitWrites;
+}
+
+static void checkDigits(SevSeg &sevseg, boolean max7219, byte numDigits) {
+  boolean ok = true;
+  for (byte digit=0 ; digit < numDigits ; digit++) {
+    ok = ok && decodedCode(max7219, numDigits, digit) == sevseg.digitCodes[digit];
+  }
+  check(ok, "decoded digits", max7219, numDigits);
+}
+
+// The MAX7219 keeps its intensity while shut down
+static void checkOn(boolean max7219, byte numDigits, boolean on, byte level) {
+  if (max7219) {
+    check(HostHAL::max7219.regs[0x0C] == on, "shutdown", max7219, numDigits);
+    check(HostHAL::max7219.regs[0x0A] == level, "intensity", max7219, numDigits);
+  }
+  else {
+    check(HostHAL::tm1637.control == (on ? 0x88 | level : 0x80), "display control",
+          max7219, numDigits);
+  }
+}
+
+static void run(boolean max7219, byte numDigitsIn) {
+  HostHAL::reset();
+  SevSeg sevseg;
+  if (max7219) {
+    HostHAL::attachMax7219(MAX7219_DATA, MAX7219_CLOCK, MAX7219_LOAD);
+    sevseg.useMAX7219(MAX7219_LOAD, MAX7219_DATA, MAX7219_CLOCK);
+  }
+  else {
+    HostHAL::attachTm1637(TM1637_DATA, TM1637_CLOCK);
+    sevseg.useTM1637(TM1637_DATA, TM1637_CLOCK);
+  }
+  sevseg.begin(0, numDigitsIn, NULL, NULL);
+  const byte capacity = max7219 ? 8 : 6;
+  const byte numDigits = (numDigitsIn < capacity) ? numDigitsIn : capacity;
+
+  // Set up and switched on, at full brightness
+  if (max7219) {
+    check(HostHAL::max7219.regs[0x09] == 0, "decode mode", max7219, numDigits);
+    check(HostHAL::max7219.regs[0x0B] == numDigits - 1, "scan limit", max7219, numDigits);
+    check(HostHAL::max7219.regs[0x0F] == 0, "display test", max7219, numDigits);
+  }
+  checkOn(max7219, numDigits, true, max7219 ? 15 : 7);
+  checkDigits(sevseg, max7219, numDigits);
+
+  for (long number = -9999 ; number < 100000 ; number += 1237) {
+    sevseg.setNumber(number, (byte)(number & 3));
+    checkDigits(sevseg, max7219, numDigits);
+  }
+  byte segments[S7_DIGITS];
+  for (byte digit=0 ; digit < S7_DIGITS ; digit++) {
+    segments[digit] = 0x5A + 17 * digit;
+  }
+  sevseg.setSegments(segments);
+  checkDigits(sevseg, max7219, numDigits);
+
+  // Only the digits that change are sent
+  if (numDigits >= 4) {
+    sevseg.setNumber(1234, 0);
+    unsigned long before = digitWrites(max7219);
+    sevseg.setNumber(1235, 0);
+    check(digitWrites(max7219) - before == 1, "one write per changed digit", max7219, numDigits);
+    before = digitWrites(max7219);
+    sevseg.increment();
+    check(digitWrites(max7219) - before == 1, "one write per increment", max7219, numDigits);
+    before = digitWrites(max7219);
+    sevseg.setNumber(1236, 0);
+    check(digitWrites(max7219) == before, "no write when unchanged", max7219, numDigits);
+    checkDigits(sevseg, max7219, numDigits);
+  }
+
+  sevseg.setBrightness(0);
+  checkOn(max7219, numDigits, true, 0);
+  sevseg.setBrightness(100);
+  checkOn(max7219, numDigits, true, max7219 ? 15 : 7);
+  sevseg.clearDisplay();
+  checkOn(max7219, numDigits, false, max7219 ? 15 : 0);
+  sevseg.refreshDisplay();
+  checkOn(max7219, numDigits, true, max7219 ? 15 : 7);
+  sevseg.clearDisplay();
+  sevseg.updateDisplay();
+  checkOn(max7219, numDigits, true, max7219 ? 15 : 7);
+  checkDigits(sevseg, max7219, numDigits);
+}
+
+int main() {
+  for (byte max7219 = 0 ; max7219 < 2 ; max7219++) {
+    for (byte numDigits = 1 ; numDigits <= S7_DIGITS ; numDigits++) {
+      run(max7219, numDigits);
+    }
+  }
+  printf("%s: %lu checks, %lu failures\n",
+         failures ? "FAIL" : "PASS", checks, failures);
+  return failures ? 1 : 0;
+}
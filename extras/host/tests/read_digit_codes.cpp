@@ -0,0 +1,72 @@
+/* SevSeg Library - readDigitCodes() stress test
+
+ Copyright 2014 Dean Reading
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+
+ Three threads share a display: a writer sets every digit to the same code,
+ over and over, another thread stands for the timer interrupt and keeps
+ calling updateDisplay(), and the main thread copies the codes with
+ readDigitCodes(). A copy with different codes would be torn: there must be
+ none.
+
+   g++ -O2 -DS7_DIGITS=4 -I extras/host -I . SevSeg.cpp \
+       extras/host/HostHAL.cpp extras/host/tests/read_digit_codes.cpp -pthread
+ */
+
+#include "SevSeg.h"
+#include <stdio.h>
+#include <thread>
+
+#define WRITES  2000000L
+
+static const byte digitPins[] = {2, 3, 4, 5};
+static const byte segmentPins[] = {6, 7, 8, 9, 10, 11, 12, 13};
+
+static SevSeg sevseg;
+static std::atomic<boolean> done(false);
+
+int main() {
+  HostHAL::reset();
+  sevseg.begin(S7_COMMON_CATHODE, 4, digitPins, segmentPins);
+  // begin() shows "0.", which would look torn: start from equal codes
+  byte blank[4] = {0, 0, 0, 0};
+  sevseg.setSegments(blank);
+
+  std::thread writer([] {
+    byte segments[4];
+    for (long write=0 ; write < WRITES ; write++) {
+      memset(segments, (byte)(write % 255 + 1), sizeof(segments));
+      sevseg.setSegments(segments);
+    }
+    done = true;
+  });
+  std::thread interrupt([] {
+    while (!done) sevseg.updateDisplay();
+  });
+
+  unsigned long reads = 0, torn = 0;
+  byte codes[4];
+  while (!done) {
+    sevseg.readDigitCodes(codes);
+    reads++;
+    if (codes[1] != codes[0] || codes[2] != codes[0] || codes[3] != codes[0]) {
+      torn++;
+    }
+  }
+  writer.join();
+  interrupt.join();
+
+  printf("%s: %lu reads, %lu torn\n", torn ? "FAIL" : "PASS", reads, torn);
+  return torn ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+/* SevSeg Library - Scan orientation test
+
+ Copyright 2014 Dean Reading
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+
+ Drives displays of 1 to 4 digits with the resistors on the digits
+ (one step per segment) and on the segments (one step per digit), for every
+ hardware configuration. After each refresh step, the LEDs lit (those whose
+ digit and segment pins are both at their 'on' level) must all share a
+ segment, or a digit, respectively. Over a frame, each digit must light
+ exactly the segments of its code.
+
+   g++ -DS7_DIGITS=4 -I extras/host -I . SevSeg.cpp \
+       extras/host/HostHAL.cpp extras/host/tests/scan_orientation.cpp
+ */
+
+#include "SevSeg.h"
+#include <stdio.h>
+
+static const byte digitPins[] = {2, 3, 4, 5};
+static const byte segmentPins[] = {6, 7, 8, 9, 10, 11, 12, 13};
+
+static unsigned long failures = 0, checks = 0;
+
+static void fail(const char *what, byte config, byte resistors,
+                 byte numDigits, long number) {
+  if (failures++ < 10) {
+    printf("FAIL %s: config %d, resistors on %s, %d digits, number %ld\n",
+           what, config, resistors == S7_R_ON_SEGMENTS ? "segments" : "digits",
+           numDigits, number);
+  }
+}
+
+// Adds the LEDs lit now to 'seen', one code per digit. Returns false if they
+// are not all in one digit (resistors on segments) or one segment (resistors
+// on digits).
+static boolean readLit(byte config, byte resistors, byte numDigits, byte seen[]) {
+  const boolean digitOn = (config == S7_COMMON_ANODE || config == S7_N_TRANSISTORS);
+  const boolean segmentOn = (config == S7_COMMON_CATHODE || config == S7_N_TRANSISTORS);
+  byte litDigits = 0, litSegments = 0;
+  for (byte digit=0 ; digit < numDigits ; digit++) {
+    if (HostHAL::level(digitPins[digit]) != digitOn) continue;
+    byte code = 0;
+    for (byte segment=0 ; segment < 8 ; segment++) {
+      if (HostHAL::level(segmentPins[segment]) == segmentOn) code |= 1 << segment;
+    }
+    if (code) litDigits++;
+    litSegments |= code;
+    seen[digit] |= code;
+  }
+  if (resistors == S7_R_ON_SEGMENTS) return litDigits <= 1;
+  return !(litSegments & (litSegments - 1)); // At most one bit set
+}
+
+static void checkFrame(SevSeg &sevseg, byte config, byte resistors,
+                       byte numDigits, long number) {
+  const byte steps = (resistors == S7_R_ON_SEGMENTS) ? numDigits : 8;
+  byte seen[4] = {0};
+  // The new frame starts once the current one is over
+  for (byte step=0 ; step < steps ; step++) {
+    sevseg.updateDisplay();
+  }
+  for (byte step=0 ; step < 2 * steps ; step++) {
+    sevseg.updateDisplay();
+    if (!readLit(config, resistors, numDigits, seen)) {
+      fail("step orientation", config, resistors, numDigits, number);
+    }
+  }
+  for (byte digit=0 ; digit < numDigits ; digit++) {
+    checks++;
+    if (seen[digit] != sevseg.digitCodes[digit]) {
+      fail("lit segments", config, resistors, numDigits, number);
+    }
+  }
+  sevseg.clearDisplay();
+  byte none[4] = {0};
+  if (!readLit(config, resistors, numDigits, none) || none[0] || none[1] ||
+      none[2] || none[3]) {
+    fail("not off", config, resistors, numDigits, number);
+  }
+}
+
+int main() {
+  for (byte resistors = S7_R_ON_DIGITS ; resistors <= S7_R_ON_SEGMENTS ; resistors++) {
+    for (byte config = S7_COMMON_CATHODE ; config <= S7_P_TRANSISTORS ; config++) {
+      for (byte numDigits = 1 ; numDigits <= 4 ; numDigits++) {
+        HostHAL::reset();
+        SevSeg sevseg;
+        sevseg.begin(config, numDigits, digitPins, segmentPins, resistors);
+        for (long number = -999 ; number < 10000 ; number += 113) {
+          sevseg.setNumber(number, (byte)(number & 3));
+          checkFrame(sevseg, config, resistors, numDigits, number);
+        }
+      }
+    }
+  }
+  printf("%s: %lu digit checks, %lu failures\n",
+         failures ? "FAIL" : "PASS", checks, failures);
+  return failures ? 1 : 0;
+}
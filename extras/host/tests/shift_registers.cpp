@@ -0,0 +1,100 @@
+/* SevSeg Library - Shift register test
+
+ Copyright 2014 Dean Reading
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+
+ Runs the same display twice, once on pins and once on a simulated chain of
+ two 74HC595 (see HostHAL::attachShiftChain()), whose outputs are numbered
+ like the pins. After every refresh step, the latched outputs must match the
+ pin levels bit for bit. Every hardware configuration and both resistor
+ locations are covered, with updateDisplay(), updateDisplayBCM() and
+ clearDisplay().
+
+   g++ -DS7_DIGITS=4 -I extras/host -I . SevSeg.cpp \
+       extras/host/HostHAL.cpp extras/host/tests/shift_registers.cpp
+ */
+
+#include "SevSeg.h"
+#include <stdio.h>
+
+#define LATCH_PIN  20
+#define DATA_PIN   21
+#define CLOCK_PIN  22
+#define FIRST      2  // The display's pins (or outputs) are FIRST..LAST
+#define LAST       13
+
+static const byte digitPins[] = {2, 3, 4, 5};
+static const byte segmentPins[] = {6, 7, 8, 9, 10, 11, 12, 13};
+
+// The levels of the display's pins or outputs after each step, one string of
+// '0' and '1' per step
+#define MAX_TRACE  20000
+static char traces[2][MAX_TRACE];
+
+static void record(char *&trace, boolean chain) {
+  for (byte pin = FIRST ; pin <= LAST ; pin++) {
+    const byte level = chain ? HostHAL::chainLevel(pin) : HostHAL::level(pin);
+    if (trace < traces[chain] + MAX_TRACE - 2) *trace++ = '0' + level;
+  }
+  *trace++ = ' ';
+  *trace = 0;
+}
+
+static void run(boolean chain, byte config, byte resistors) {
+  HostHAL::reset();
+  SevSeg sevseg;
+  if (chain) {
+    HostHAL::attachShiftChain(DATA_PIN, CLOCK_PIN, LATCH_PIN, 2);
+    sevseg.useShiftRegisters(LATCH_PIN, DATA_PIN, CLOCK_PIN);
+  }
+  sevseg.begin(config, 4, digitPins, segmentPins, resistors);
+  char *trace = traces[chain];
+  *trace = 0;
+
+  const long numbers[] = {0, 7, 42, -5, 999, 1000, -99, 1234, 88888};
+  for (byte n=0 ; n < sizeof(numbers) / sizeof(numbers[0]) ; n++) {
+    sevseg.setNumber(numbers[n], (byte)(n % 4));
+    sevseg.setMinimalTransitions(n & 1);
+    for (byte step=0 ; step < 20 ; step++) {
+      sevseg.updateDisplay();
+      record(trace, chain);
+    }
+    sevseg.setDigitBrightness(n % 4, 100);
+    for (byte plane=0 ; plane < 3 * S7_BCM_BITS ; plane++) {
+      sevseg.updateDisplayBCM();
+      record(trace, chain);
+    }
+    sevseg.clearDisplay();
+    record(trace, chain);
+  }
+}
+
+int main() {
+  unsigned long failures = 0, checks = 0;
+  for (byte resistors = S7_R_ON_DIGITS ; resistors <= S7_R_ON_SEGMENTS ; resistors++) {
+    for (byte config = S7_COMMON_CATHODE ; config <= S7_P_TRANSISTORS ; config++) {
+      run(false, config, resistors);
+      run(true, config, resistors);
+      checks++;
+      if (strcmp(traces[0], traces[1])) {
+        failures++;
+        printf("FAIL: config %d, resistors on %s\n", config,
+               resistors == S7_R_ON_SEGMENTS ? "segments" : "digits");
+      }
+    }
+  }
+  printf("%s: %lu displays compared, %lu failures\n",
+         failures ? "FAIL" : "PASS", checks, failures);
+  return failures ? 1 : 0;
+}
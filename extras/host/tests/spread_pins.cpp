@@ -0,0 +1,84 @@
+/* SevSeg Library - Spread pins test
+
+ Copyright 2014 Dean Reading
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+
+ Spreads the segment pins over all 4 simulated ports, as on a Leonardo or a
+ Mega, and checks that over a frame each digit lights exactly the segments of
+ its code, for every hardware configuration and both resistor locations.
+ Build it twice: with the default S7_PORTS, the pins fit and the ports are
+ written directly; with S7_PORTS=3 they do not, and must be driven with
+ digitalWrite() instead of being dropped.
+
+   g++ -DS7_DIGITS=4 -I extras/host -I . SevSeg.cpp \
+       extras/host/HostHAL.cpp extras/host/tests/spread_pins.cpp
+   g++ -DS7_DIGITS=4 -DS7_PORTS=3 -I extras/host -I . SevSeg.cpp \
+       extras/host/HostHAL.cpp extras/host/tests/spread_pins.cpp
+ */
+
+#include "SevSeg.h"
+#include <stdio.h>
+
+static const byte digitPins[] = {2, 3, 4, 5};
+static const byte segmentPins[] = {6, 7, 8, 9, 16, 17, 24, 25};
+static byte codes[][4] = {{0x7F, 0xFF, 0x80, 0x01},
+                          {0xC0, 0x3F, 0x06, 0x5B},
+                          {0xFF, 0xFF, 0xFF, 0xFF}};
+
+static unsigned long failures = 0, checks = 0;
+
+int main() {
+  for (byte resistors = S7_R_ON_DIGITS ; resistors <= S7_R_ON_SEGMENTS ; resistors++) {
+    for (byte config = S7_COMMON_CATHODE ; config <= S7_P_TRANSISTORS ; config++) {
+      const boolean digitOn = (config == S7_COMMON_ANODE || config == S7_N_TRANSISTORS);
+      const boolean segmentOn = (config == S7_COMMON_CATHODE || config == S7_N_TRANSISTORS);
+      HostHAL::reset();
+      SevSeg sevseg;
+      sevseg.begin(config, 4, digitPins, segmentPins, resistors);
+      const byte steps = (resistors == S7_R_ON_SEGMENTS) ? 4 : 8;
+
+      for (byte set=0 ; set < sizeof(codes) / sizeof(codes[0]) ; set++) {
+        sevseg.setSegments(codes[set]);
+        // The new frame starts once the current one is over
+        for (byte step=0 ; step < steps ; step++) {
+          sevseg.updateDisplay();
+        }
+        byte seen[4] = {0};
+        for (byte step=0 ; step < steps ; step++) {
+          sevseg.updateDisplay();
+          for (byte digit=0 ; digit < 4 ; digit++) {
+            if (HostHAL::level(digitPins[digit]) != digitOn) continue;
+            for (byte segment=0 ; segment < 8 ; segment++) {
+              if (HostHAL::level(segmentPins[segment]) == segmentOn) {
+                seen[digit] |= 1 << segment;
+              }
+            }
+          }
+        }
+        for (byte digit=0 ; digit < 4 ; digit++) {
+          checks++;
+          if (seen[digit] != codes[set][digit] && failures++ < 10) {
+            printf("FAIL config %d, resistors on %s, digit %d: lit 0x%02X "
+                   "instead of 0x%02X\n", config,
+                   resistors == S7_R_ON_SEGMENTS ? "segments" : "digits",
+                   digit, seen[digit], codes[set][digit]);
+          }
+        }
+      }
+    }
+  }
+  printf("%s: %lu digit checks, %lu failures\n",
+         failures ? "FAIL" : "PASS", checks, failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,76 @@
+/* SevSeg Library - Stalled display test
+
+ Copyright 2014 Dean Reading
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+
+ Sets many numbers while the display is not refreshed (e.g. with the timer
+ stopped), then resumes it and changes some of the digits. The frame the
+ setters edit must start from the latest one published, however many were
+ published meanwhile: the digits left unchanged must not come from an older
+ frame. Build it with several values of S7_FRAMES:
+
+   g++ -DS7_DIGITS=4 -DS7_FRAMES=2 -I extras/host -I . SevSeg.cpp \
+       extras/host/HostHAL.cpp extras/host/tests/stalled_display.cpp
+ */
+
+#include "SevSeg.h"
+#include <stdio.h>
+
+static const byte digitPins[] = {2, 3, 4, 5};
+static const byte segmentPins[] = {6, 7, 8, 9, 10, 11, 12, 13};
+
+// The number of digits shown with other segments than their code, over a
+// frame (common cathode, resistors on segments)
+static byte wrongDigits(SevSeg &sevseg) {
+  byte wrong = 0;
+  for (byte step=0 ; step < 8 ; step++) {
+    sevseg.updateDisplay();
+    for (byte digit=0 ; digit < 4 ; digit++) {
+      if (HostHAL::level(digitPins[digit]) != LOW) continue;
+      byte code = 0;
+      for (byte segment=0 ; segment < 8 ; segment++) {
+        if (HostHAL::level(segmentPins[segment])) code |= 1 << segment;
+      }
+      if (code != sevseg.digitCodes[digit]) wrong++;
+    }
+  }
+  return wrong;
+}
+
+int main() {
+  unsigned long failures = 0, checks = 0;
+  for (int stalled = 1 ; stalled < 1100 ; stalled++) {
+    HostHAL::reset();
+    SevSeg sevseg;
+    sevseg.begin(S7_COMMON_CATHODE, 4, digitPins, segmentPins, S7_R_ON_SEGMENTS);
+    sevseg.setNumber(1234, 0);
+    wrongDigits(sevseg);
+
+    // Alternates between 1231 and 1232
+    for (int number=0 ; number < stalled ; number++) {
+      sevseg.setNumber(1231 + number % 2, 0);
+    }
+    wrongDigits(sevseg); // Resume
+    sevseg.setNumber(5600 + 31 + (stalled - 1) % 2, 0); // Same last 2 digits
+    wrongDigits(sevseg); // The new frame is shown from the next frame on
+
+    checks++;
+    if (wrongDigits(sevseg)) {
+      if (failures++ < 10) printf("FAIL: %d numbers set while stalled\n", stalled);
+    }
+  }
+  printf("%s: %lu checks, %lu failures\n",
+         failures ? "FAIL" : "PASS", checks, failures);
+  return failures ? 1 : 0;
+}
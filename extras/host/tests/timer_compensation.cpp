@@ -0,0 +1,104 @@
+/* SevSeg Library - Timer compensation test
+
+ Copyright 2014 Dean Reading
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+
+ Refreshes "1 8.1 8." from the simulated timer, with the resistors on the
+ segments (one step per digit), and measures how long each digit stays lit.
+ Without compensation, all digits are lit for the same part of their step.
+ With it, each LED beyond the first must lengthen that part by perLed/256,
+ up to the whole step: a digit must never stay lit longer because of the
+ step that comes after it.
+
+   g++ -DS7_DIGITS=4 -I extras/host -I . SevSeg.cpp \
+       extras/host/HostHAL.cpp extras/host/tests/timer_compensation.cpp
+ */
+
+#include "SevSeg.h"
+#include "SevSegTimer.h"
+#include <stdio.h>
+#include <math.h>
+
+#define STEP_US     1000 // Timer tick: one step
+#define MEASURE_US  400000UL
+#define TOLERANCE   0.01
+
+static const byte digitPins[] = {2, 3, 4, 5};
+static const byte segmentPins[] = {6, 7, 8, 9, 10, 11, 12, 13};
+static byte codes[] = {0x06, 0xFF, 0x06, 0xFF}; // "1 8.1 8."
+static const byte extraLit[] = {1, 7, 1, 7};    // LEDs beyond the first
+
+static unsigned long failures = 0, checks = 0;
+
+// Part of its own steps that each digit is lit, common cathode
+static void measure(byte level, byte perLed, double lit[]) {
+  HostHAL::reset();
+  SevSeg sevseg;
+  sevseg.begin(S7_COMMON_CATHODE, 4, digitPins, segmentPins, S7_R_ON_SEGMENTS);
+  sevseg.setSegments(codes);
+  sevseg.setBrightnessLevel(level);
+  sevseg.setCompensation(perLed);
+  SevSegTimer::begin(sevseg, 1000000UL / STEP_US);
+  HostHAL::advance(10 * STEP_US); // Let the new frame start
+
+  unsigned long litTime[4] = {0};
+  for (unsigned long time=0 ; time < MEASURE_US ; time++) {
+    HostHAL::advance(1);
+    for (byte digit=0 ; digit < 4 ; digit++) {
+      if (HostHAL::level(digitPins[digit]) != LOW) continue;
+      for (byte segment=0 ; segment < 8 ; segment++) {
+        if (HostHAL::level(segmentPins[segment])) {
+          litTime[digit]++;
+          break;
+        }
+      }
+    }
+  }
+  SevSegTimer::end();
+  for (byte digit=0 ; digit < 4 ; digit++) {
+    lit[digit] = (double)litTime[digit] * 4 / MEASURE_US;
+  }
+}
+
+static void check(byte level, byte perLed) {
+  double plain[4], compensated[4];
+  measure(level, 0, plain);
+  measure(level, perLed, compensated);
+  for (byte digit=0 ; digit < 4 ; digit++) {
+    checks++;
+    double expected = plain[0] * (1 + perLed * extraLit[digit] / 256.0);
+    if (expected > 1) expected = 1;
+    if (fabs(plain[digit] - plain[0]) > TOLERANCE ||
+        fabs(compensated[digit] - expected) > TOLERANCE) {
+      if (failures++ < 10) {
+        printf("FAIL level %d, perLed %d, digit %d: lit %.3f without "
+               "compensation, %.3f with it (expected %.3f)\n", level, perLed,
+               digit, plain[digit], compensated[digit], expected);
+      }
+    }
+  }
+}
+
+int main() {
+  const byte levels[] = {60, 130, 200};
+  const byte perLeds[] = {16, 64, 255};
+  for (byte level=0 ; level < sizeof(levels) ; level++) {
+    for (byte perLed=0 ; perLed < sizeof(perLeds) ; perLed++) {
+      check(levels[level], perLeds[perLed]);
+    }
+  }
+  printf("%s: %lu digit checks, %lu failures\n",
+         failures ? "FAIL" : "PASS", checks, failures);
+  return failures ? 1 : 0;
+}